@@ -0,0 +1,22 @@
+/*
+ * affinity.c - 스레드 CPU 고정 (affinity.h 참고)
+ */
+#define _GNU_SOURCE
+#include "affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+int affinity_pin(int cpu) {
+    cpu_set_t set;
+    int rc = pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) return rc;
+
+    // 허용된 CPU 중 k 번째 (cgroup / taskset 으로 좁혀져 있어도 그 안에서 고름)
+    int n = CPU_COUNT(&set), k = cpu % (n > 0 ? n : 1), c;
+    for (c = 0; c < CPU_SETSIZE - 1; c++)
+        if (CPU_ISSET(c, &set) && k-- == 0) break;
+    CPU_ZERO(&set);
+    CPU_SET(c, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
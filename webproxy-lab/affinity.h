@@ -0,0 +1,14 @@
+/*
+ * affinity.h - 스레드를 CPU 코어에 고정
+ *
+ * cpu_set_t / pthread_setaffinity_np 는 _GNU_SOURCE 가 있어야 보이는데
+ * csapp.h 의 선언과 부딪혀서 따로 컴파일함
+ */
+#ifndef __AFFINITY_H__
+#define __AFFINITY_H__
+
+/* 호출한 스레드를 쓸 수 있는 CPU 중 cpu 번째에 고정 (개수보다 크면 나머지로).
+   성공 0, 실패하면 에러 번호 (고정은 안 된 채로) */
+int affinity_pin(int cpu);
+
+#endif /* __AFFINITY_H__ */
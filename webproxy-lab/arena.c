@@ -0,0 +1,96 @@
+/*
+ * arena.c - 연결 단위 bump 할당기 (arena.h 참고)
+ */
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+static ArenaBlock *block_new(size_t cap) {
+    ArenaBlock *b = malloc(sizeof(*b) + cap);
+    if (!b) return NULL;
+    b->next = NULL;
+    b->cap = cap;
+    b->used = 0;
+    return b;
+}
+
+void arena_init(Arena *a, size_t block_size) {
+    a->head = NULL;
+    a->block_size = block_size;
+}
+
+void *arena_alloc(Arena *a, size_t n) {
+    n = ALIGN8(n);
+    ArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        // 큰 요청은 그 크기 그대로 블록을 만듦
+        b = block_new(n > a->block_size ? n : a->block_size);
+        if (!b) return NULL;
+        b->next = a->head;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+void *arena_grow(Arena *a, void *p, size_t oldn, size_t newn) {
+    ArenaBlock *b = a->head;
+    if (p && b && (char *)p + ALIGN8(oldn) == b->data + b->used &&
+        b->used - ALIGN8(oldn) + ALIGN8(newn) <= b->cap) {
+        b->used = b->used - ALIGN8(oldn) + ALIGN8(newn);
+        return p;
+    }
+    void *q = arena_alloc(a, newn);
+    if (q && p) memcpy(q, p, oldn);
+    return q;
+}
+
+char *arena_strndup(Arena *a, const char *s, size_t n) {
+    char *p = arena_alloc(a, n + 1);
+    if (!p) return NULL;
+    memcpy(p, s, n);
+    p[n] = '\0';
+    return p;
+}
+
+void arena_reset(Arena *a) {
+    ArenaBlock *b = a->head;
+    if (!b) return;
+    // 가장 처음 만든 블록(리스트 끝)만 남김
+    while (b->next) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    b->used = 0;
+    a->head = b;
+}
+
+void arena_free(Arena *a) {
+    ArenaBlock *b = a->head;
+    while (b) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+}
+
+int str_append(Arena *a, Str *str, const char *s, size_t n) {
+    if (str->len + n + 1 > str->cap) {
+        size_t cap = str->cap ? str->cap : 256;
+        while (cap < str->len + n + 1) cap *= 2;
+        char *p = arena_grow(a, str->s, str->cap, cap);
+        if (!p) return -1;
+        str->s = p;
+        str->cap = cap;
+    }
+    memcpy(str->s + str->len, s, n);
+    str->len += n;
+    str->s[str->len] = '\0';
+    return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * arena.h - 연결 하나 동안 쓰는 bump 할당기
+ *
+ * 요청 처리 중 필요한 문자열/버퍼를 스택 대신 여기서 필요한 크기만큼 잘라 씀.
+ * 개별 free 는 없고 연결이 끝나면 arena_reset / arena_free 로 한 번에 정리
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t cap;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;       /* 현재 할당 중인 블록 */
+    size_t block_size;      /* 새 블록 기본 크기 */
+} Arena;
+
+/* arena 에서 키워 가는 문자열 */
+typedef struct {
+    char *s;
+    size_t len;
+    size_t cap;
+} Str;
+
+void arena_init(Arena *a, size_t block_size);
+void *arena_alloc(Arena *a, size_t n);                    /* 실패 시 NULL, 8바이트 정렬 */
+void *arena_grow(Arena *a, void *p, size_t oldn, size_t newn);  /* 마지막 할당이면 제자리 확장 */
+char *arena_strndup(Arena *a, const char *s, size_t n);
+void arena_reset(Arena *a);   /* 첫 블록만 남기고 비움 (다음 연결에서 재사용) */
+void arena_free(Arena *a);
+
+/* s 뒤에 n 바이트를 붙이고 NUL 종료. 실패 -1 */
+int str_append(Arena *a, Str *str, const char *s, size_t n);
+
+#endif /* __ARENA_H__ */
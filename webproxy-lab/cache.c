@@ -0,0 +1,1027 @@
+/*
+ * cache.c - 샤드 단위 해시 인덱스 + 교체 정책 캐시 (cache.h 참고)
+ */
+#include "cache.h"
+#include "slab.h"
+#include "disk.h"
+#include "tinylfu.h"
+#include "policy.h"
+#include "radix.h"
+#include "http.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>   // 참조 수
+
+struct Entry;
+
+// 엔트리가 단 태그 하나. 같은 태그를 단 엔트리들끼리 이중 연결 (머리는 샤드 tags radix 의 값)
+typedef struct TagRef {
+    struct Entry *ent;
+    const char *name;                 // 객체 헤더 안 (객체는 엔트리가 살아 있는 동안 안 바뀜)
+    size_t len;
+    struct TagRef *prev, *next;
+} TagRef;
+
+typedef struct Entry {
+    PolNode pn;                       // 교체 정책 몫 (크기, key 해시 포함). 첫 멤버라 서로 캐스팅
+    char *key;
+    CacheObj *obj;                    // 캐시가 참조 하나를 들고 있음
+    struct Entry *hnext;              // 같은 버킷 체인
+    TagRef *tags;                     // Surrogate-Key 태그들 (없으면 NULL)
+    size_t ntags;                     // 역색인에 건 수
+} Entry;
+
+#define CACHE_MIN_BUCKETS 64
+#define CACHE_MAX_SHARDS 256
+#define REHASH_STEP 8      // 삽입 한 번에 옮기는 옛 버킷 수
+#define ADMIT_AVG_OBJECT 512    // 빈도 스케치 크기 잡을 때 가정하는 평균 객체 크기 (작게 잡아 넉넉히)
+
+#define FLIGHT_CHUNK (64 * 1024)   // flight 버퍼 조각. 한 번 잡으면 옮기지 않음 -> 읽는 쪽은 락 밖에서 복사
+
+struct Flight {
+    char *key;
+    uint64_t hash;
+    uint64_t epoch;             // 시작할 때의 샤드 무효화 세대 (그 뒤 PURGE 가 있었으면 저장 안 함)
+    struct Flight *next;        // 샤드의 진행 중 목록 (fl_lock)
+    struct CacheShard *shard;
+    int listed;                 // 목록에 있으면 1 (새 요청이 따라올 수 있음)
+    _Atomic int refs;           // 리더 + 따라온 요청 수
+
+    pthread_mutex_t mu;         // 아래 필드 보호
+    pthread_cond_t cond;        // 새 바이트 / 끝
+    char **chunks;              // FLIGHT_CHUNK 크기 조각들. [0, len) 는 불변
+    size_t nchunks, chunk_cap;
+    size_t len;                 // 채워진 바이트
+    int done, failed;
+    int oversize;               // 상한을 넘음: 저장은 안 하고 이미 읽기 시작한 요청에게만 계속 보냄
+    int dropped;                // 읽는 요청이 없거나 메모리 부족: 버퍼링 중단
+    FlightWaiter *waiters;      // 비동기 대기자 (한 번 깨우면 빠짐)
+};
+
+// 샤드끼리 같은 캐시 라인을 쓰지 않도록 64바이트 정렬
+typedef struct CacheShard {
+    _Alignas(64) pthread_rwlock_t rw;
+    void *pol;         // 교체 정책 상태 (g_policy)
+    size_t bytes_used;
+    size_t budget;     // 이 샤드의 바이트 예산
+    Entry **buckets;   // key -> Entry 해시 인덱스 (체이닝, 크기는 2의 거듭제곱)
+    size_t nbuckets;
+    Entry **old;       // 점진 rehash 중인 옛 테이블 (없으면 NULL)
+    size_t nold;
+    size_t rehash_idx; // 다음에 옮길 옛 버킷
+    size_t count;      // 엔트리 수
+    Radix keys;        // key -> Entry (prefix 무효화용, 해시 인덱스와 같이 유지)
+    Radix tags;        // 태그 -> 그 태그를 단 TagRef 목록 머리
+    size_t size_hist[CACHE_SIZE_BUCKETS];   // 객체 크기 분포 (쓰기 락)
+    pthread_mutex_t fl_lock;   // 진행 중 fetch 목록 보호
+    Flight *flights;
+    // 무효화 세대: 쓰기 락 안에서 디스크 사본까지 뺀 뒤에 올림.
+    // 그 전에 디스크에서 읽었거나 origin 에 요청한 객체는 cache_link 가 버림
+    _Atomic uint64_t epoch;
+
+    // 통계 (relaxed atomic). 락과 다른 캐시 라인, 다른 샤드와도 공유하지 않음
+    _Alignas(64) _Atomic unsigned long hits;
+    _Atomic unsigned long stale, misses, disk_hits, coalesced;
+    _Atomic unsigned long inserts, evictions, rejected, purged;
+} CacheShard;
+
+#define STAT_INC(s, field) atomic_fetch_add_explicit(&(s)->field, 1, memory_order_relaxed)
+
+static CacheShard *g_shards;
+static int g_nshards;
+static size_t g_capacity = MAX_CACHE_SIZE;
+static size_t g_max_object = MAX_OBJECT_SIZE;
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static int g_req_shards = CACHE_DEFAULT_SHARDS;
+static int g_admission = 1;   // TinyLFU 입장 허가
+static double g_ahead_frac = 0;     // 미리 갱신 시점 (수명 비율, 0 이면 안 함)
+static unsigned g_ahead_hits = 1;   // 미리 갱신할 만큼 뜨거운 객체의 수명당 히트 수
+static const Policy *g_policy;   // NULL 이면 clock
+static _Atomic uint64_t g_gen_seen;   // 맞춰 둔 공유 무효화 세대 (disk_shared 일 때만)
+
+static void cache_setup(void) {
+    int n = g_req_shards;
+    size_t max_by_budget = g_capacity / g_max_object;
+    if ((size_t)n > max_by_budget) n = (int)max_by_budget;
+    if (n > CACHE_MAX_SHARDS) n = CACHE_MAX_SHARDS;
+    if (n < 1) n = 1;
+
+    g_shards = aligned_alloc(64, sizeof(CacheShard) * n);
+    if (!g_shards) abort();
+    memset(g_shards, 0, sizeof(CacheShard) * n);
+    if (!g_policy) g_policy = policy_find("clock");
+    for (int i = 0; i < n; i++) {
+        if (!(g_shards[i].pol = g_policy->create(g_capacity / n))) abort();
+        pthread_rwlock_init(&g_shards[i].rw, NULL);
+        pthread_mutex_init(&g_shards[i].fl_lock, NULL);
+        g_shards[i].budget = g_capacity / n;
+    }
+    g_nshards = n;
+    tinylfu_init(g_capacity / ADMIT_AVG_OBJECT);
+}
+
+void cache_init(size_t capacity, size_t max_object, int nshards) {
+    static pthread_mutex_t cfg_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&cfg_lock);
+    if (!g_shards) {
+        if (capacity) g_capacity = capacity;
+        if (max_object) g_max_object = max_object;
+        if (g_max_object > g_capacity) g_max_object = g_capacity;
+        if (nshards > 0) g_req_shards = nshards;
+    }
+    pthread_mutex_unlock(&cfg_lock);
+    pthread_once(&g_init_once, cache_setup);
+}
+
+int cache_nshards(void) {
+    cache_init(0, 0, 0);
+    return g_nshards;
+}
+
+size_t cache_capacity(void) {
+    return g_capacity;
+}
+
+size_t cache_max_object(void) {
+    return g_max_object;
+}
+
+void cache_set_admission(int on) {
+    g_admission = on;
+}
+
+void cache_set_refresh_ahead(double frac, unsigned min_hits) {
+    g_ahead_frac = frac;
+    g_ahead_hits = min_hits ? min_hits : 1;
+}
+
+int cache_ahead_due(CacheObj *obj) {
+    if (g_ahead_frac <= 0) return 0;
+    time_t born = atomic_load_explicit(&obj->born, memory_order_relaxed);
+    time_t expires = atomic_load_explicit(&obj->expires, memory_order_relaxed);
+    if (time(NULL) < born + (time_t)((double)(expires - born) * g_ahead_frac)) return 0;
+    if (atomic_load_explicit(&obj->hits, memory_order_relaxed) < g_ahead_hits) return 0;
+    // 동시에 여러 히트가 와도 갱신은 하나만
+    int expect = 0;
+    return atomic_compare_exchange_strong(&obj->ahead, &expect, 1);
+}
+
+void cache_stats(CacheStats *st) {
+    cache_init(0, 0, 0);
+    memset(st, 0, sizeof(*st));
+    st->capacity = g_capacity;
+    for (int i = 0; i < g_nshards; i++) {
+        CacheShard *s = &g_shards[i];
+        st->hits += atomic_load_explicit(&s->hits, memory_order_relaxed);
+        st->stale += atomic_load_explicit(&s->stale, memory_order_relaxed);
+        st->misses += atomic_load_explicit(&s->misses, memory_order_relaxed);
+        st->disk_hits += atomic_load_explicit(&s->disk_hits, memory_order_relaxed);
+        st->coalesced += atomic_load_explicit(&s->coalesced, memory_order_relaxed);
+        st->inserts += atomic_load_explicit(&s->inserts, memory_order_relaxed);
+        st->evictions += atomic_load_explicit(&s->evictions, memory_order_relaxed);
+        st->rejected += atomic_load_explicit(&s->rejected, memory_order_relaxed);
+        st->purged += atomic_load_explicit(&s->purged, memory_order_relaxed);
+
+        pthread_rwlock_rdlock(&s->rw);
+        st->bytes_used += s->bytes_used;
+        st->entries += s->count;
+        for (int b = 0; b < CACHE_SIZE_BUCKETS; b++) st->size_hist[b] += s->size_hist[b];
+        pthread_rwlock_unlock(&s->rw);
+    }
+}
+
+int cache_set_policy(const char *name) {
+    const Policy *p = policy_find(name);
+    if (!p || g_shards) return -1;
+    g_policy = p;
+    return 0;
+}
+
+const char *cache_policy(void) {
+    return g_policy ? g_policy->name : "clock";
+}
+
+const char *cache_policy_names(void) {
+    return policy_names();
+}
+
+/* Utility*/
+// FNV-1a 64bit
+static uint64_t hash_key(const char *key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// 버킷은 해시 하위 비트를 쓰므로 샤드는 상위 비트로 고름.
+// FNV 상위 비트는 끝 글자만 다른 key 들 (obj/1, obj/2, ...) 에서 몇 샤드에 몰리므로 한 번 섞어서 씀
+static CacheShard *shard_of(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return &g_shards[(h >> 32) % (uint64_t)g_nshards];
+}
+
+static Entry* find_in(Entry **tab, size_t n, const char *key, uint64_t h) {
+    for (Entry *ent = tab[h & (n - 1)]; ent; ent = ent->hnext)
+        if (ent->pn.hash == h && strcmp(ent->key, key) == 0) return ent;
+    return NULL;
+}
+
+// rehash 중이면 아직 안 옮겨진 옛 테이블도 봄
+static Entry* find_entry(CacheShard *s, const char *key, uint64_t h) {
+    if (!s->buckets) return NULL;
+    Entry *ent = find_in(s->buckets, s->nbuckets, key, h);
+    if (!ent && s->old) ent = find_in(s->old, s->nold, key, h);
+    return ent;
+}
+
+/* 점진 rehash: 테이블을 키울 때 한 번에 다 옮기지 않고 삽입마다 몇 버킷씩 옮김.
+  엔트리가 수백만 개여도 쓰기 락을 잡은 채 전체를 다시 거는 일이 없음 */
+static void rehash_step(CacheShard *s, int nbuckets) {
+    while (s->old && nbuckets-- > 0) {
+        Entry *ent = s->old[s->rehash_idx];
+        while (ent) {
+            Entry *next = ent->hnext;
+            size_t idx = ent->pn.hash & (s->nbuckets - 1);
+            ent->hnext = s->buckets[idx];
+            s->buckets[idx] = ent;
+            ent = next;
+        }
+        s->old[s->rehash_idx] = NULL;
+        if (++s->rehash_idx == s->nold) {
+            free(s->old);
+            s->old = NULL;
+            s->nold = s->rehash_idx = 0;
+        }
+    }
+}
+
+// 새 테이블을 잡고 옛 테이블은 rehash 대상으로. 실패하면 기존 테이블 유지
+static int index_grow(CacheShard *s, size_t n) {
+    Entry **nb = calloc(n, sizeof(Entry *));
+    if (!nb) return -1;
+    if (s->buckets) {
+        s->old = s->buckets;
+        s->nold = s->nbuckets;
+        s->rehash_idx = 0;
+    }
+    s->buckets = nb;
+    s->nbuckets = n;
+    return 0;
+}
+
+// 인덱스 (해시 + radix) 에 추가. 부하율이 1을 넘으면 버킷을 두 배로 (이전 rehash 가 끝난 뒤)
+static int index_insert(CacheShard *s, Entry *ent) {
+    if (!s->buckets && index_grow(s, CACHE_MIN_BUCKETS) < 0) return -1;
+    if (radix_insert(&s->keys, ent->key, strlen(ent->key), ent) < 0) return -1;
+    rehash_step(s, REHASH_STEP);
+    if (!s->old && s->count + 1 > s->nbuckets) index_grow(s, s->nbuckets * 2);
+
+    size_t idx = ent->pn.hash & (s->nbuckets - 1);
+    ent->hnext = s->buckets[idx];
+    s->buckets[idx] = ent;
+    s->count++;
+    return 0;
+}
+
+static int unlink_from(Entry **tab, size_t n, Entry *ent) {
+    Entry **pp = &tab[ent->pn.hash & (n - 1)];
+    while (*pp && *pp != ent) pp = &(*pp)->hnext;
+    if (!*pp) return 0;
+    *pp = ent->hnext;
+    return 1;
+}
+
+// 응답 헤더의 Surrogate-Key 값 (없으면 0)
+static int obj_tags(const CacheObj *obj, const char **v, size_t *n) {
+    HttpMeta m;
+    size_t hlen = http_header_end(obj->data, obj->size);
+    if (!hlen || http_parse_response(obj->data, hlen, &m) < 0 || !m.skeys) return 0;
+    *v = m.skeys;
+    *n = m.skeys_len;
+    return *n > 0;
+}
+
+// 공백으로 나눈 다음 태그 (없으면 NULL)
+static const char *next_tag(const char **p, const char *end, size_t *len) {
+    const char *v = *p;
+    while (v < end && (*v == ' ' || *v == '\t')) v++;
+    const char *tag = v;
+    while (v < end && *v != ' ' && *v != '\t') v++;
+    *p = v;
+    *len = (size_t)(v - tag);
+    return *len ? tag : NULL;
+}
+
+// 태그마다 역색인 목록 머리에 끼움. 메모리 부족 -1 (건 만큼은 ntags 에 남아 tags_detach 가 풂)
+static int tags_attach(CacheShard *s, Entry *ent, const char *v, size_t n) {
+    const char *p = v, *end = v + n;
+    size_t len, cnt = 0;
+    while (next_tag(&p, end, &len)) cnt++;
+    if (!cnt) return 0;
+    if (!(ent->tags = calloc(cnt, sizeof(*ent->tags)))) return -1;
+
+    const char *tag;
+    for (p = v; (tag = next_tag(&p, end, &len)); ) {
+        TagRef *head = radix_get(&s->tags, tag, len);
+        if (head && head->ent == ent) continue;   // 같은 태그가 두 번 (방금 이 엔트리가 머리에 넣음)
+        TagRef *r = &ent->tags[ent->ntags];
+        *r = (TagRef){ ent, tag, len, NULL, head };
+        if (radix_insert(&s->tags, tag, len, r) < 0) return -1;
+        if (head) head->prev = r;
+        ent->ntags++;
+    }
+    return 0;
+}
+
+static void tags_detach(CacheShard *s, Entry *ent) {
+    for (size_t i = 0; i < ent->ntags; i++) {
+        TagRef *r = &ent->tags[i];
+        if (r->next) r->next->prev = r->prev;
+        if (r->prev) r->prev->next = r->next;
+        else if (r->next) radix_insert(&s->tags, r->name, r->len, r->next);   // 있는 key 라 할당 없음
+        else radix_remove(&s->tags, r->name, r->len);
+    }
+    free(ent->tags);
+    ent->tags = NULL;
+    ent->ntags = 0;
+}
+
+static void index_remove(CacheShard *s, Entry *ent) {
+    tags_detach(s, ent);
+    if (unlink_from(s->buckets, s->nbuckets, ent) ||
+        (s->old && unlink_from(s->old, s->nold, ent))) {
+        s->count--;
+        radix_remove(&s->keys, ent->key, strlen(ent->key));
+    }
+    ent->hnext = NULL;
+}
+
+void cache_retain(CacheObj *obj) {
+    atomic_fetch_add_explicit(&obj->refs, 1, memory_order_relaxed);
+}
+
+void cache_release(CacheObj *obj) {
+    if (obj && atomic_fetch_sub_explicit(&obj->refs, 1, memory_order_acq_rel) == 1)
+        slab_free(obj, sizeof(*obj) + obj->size);
+}
+
+// 엔트리만 해제. 객체는 아직 읽는 요청이 있으면 그쪽이 마지막에 해제
+static void free_entry(Entry *ent) {
+    free(ent->key);
+    cache_release(ent->obj);
+    free(ent);
+}
+
+// 객체 크기 분포 칸: i 칸은 (1K << i) 미만, 마지막 칸은 나머지 전부
+static int size_bucket(size_t n) {
+    int i = 0;
+    while (i < CACHE_SIZE_BUCKETS - 1 && n >= ((size_t)1024 << i)) i++;
+    return i;
+}
+
+// 정책, 인덱스, 예산에서 모두 빼고 해제 (evicted: 예산 때문에 내보냄)
+static void remove_entry(CacheShard *s, Entry *ent, int evicted) {
+    s->bytes_used -= ent->pn.size;
+    s->size_hist[size_bucket(ent->obj->size)]--;
+    if (evicted) STAT_INC(s, evictions);
+    g_policy->remove(s->pol, &ent->pn, evicted);
+    index_remove(s, ent);
+    free_entry(ent);
+}
+
+// 히트면 참조 하나 잡아서 돌려줌
+static CacheObj *lookup(CacheShard *s, const char *key, uint64_t h) {
+    CacheObj *obj = NULL;
+
+    pthread_rwlock_rdlock(&s->rw);               
+    Entry *ent = find_entry(s, key, h);
+    if (ent) {
+        // 복사 없이 참조만 잡음. 그 사이 evict 돼도 객체는 살아 있음
+        obj = ent->obj;
+        atomic_fetch_add_explicit(&obj->refs, 1, memory_order_relaxed);
+
+        // 정책에는 표시만 (읽기 락이라 리스트는 안 건드림)
+        g_policy->hit(s->pol, &ent->pn);
+    }
+    pthread_rwlock_unlock(&s->rw);
+
+    return obj;
+}
+
+typedef struct {
+    CacheShard *s;
+    CacheObj *obj;
+    size_t real;
+} DiskFill;
+
+static CacheObj *obj_alloc(CacheShard *s, size_t n, size_t *real);
+static void cache_link(CacheShard *s, const char *key, uint64_t h, CacheObj *obj, size_t real,
+                       const char *tags, size_t tlen, int negative, uint64_t epoch, int on_disk);
+
+static uint64_t shard_epoch(CacheShard *s) {
+    return atomic_load_explicit(&s->epoch, memory_order_acquire);
+}
+
+// 쓰기 락 안에서, 무효화한 key 의 디스크 사본까지 다 뺀 뒤에
+static void bump_epoch(CacheShard *s) {
+    atomic_fetch_add_explicit(&s->epoch, 1, memory_order_release);
+}
+
+// disk_get 이 본문을 복사할 자리 = 새 객체
+static void *disk_fill(void *arg, size_t n) {
+    DiskFill *df = arg;
+    df->obj = obj_alloc(df->s, n, &df->real);
+    return df->obj ? df->obj->data : NULL;
+}
+
+// 메모리 미스면 디스크 계층에서 찾아 메모리로 올림. 참조 하나 잡아서 돌려줌
+static CacheObj *disk_promote(CacheShard *s, const char *key, uint64_t h) {
+    DiskFill df = { s, NULL, 0 };
+    time_t expires;
+
+    if (!disk_enabled()) return NULL;
+    // 읽은 뒤 올리기 전에 PURGE 가 끼면 cache_link 가 버림 (호출자에게는 이번 한 번 보냄)
+    uint64_t epoch = shard_epoch(s);
+    if (!disk_get(key, h, &expires, disk_fill, &df)) {
+        cache_release(df.obj);   // 복사 뒤에 덮였거나 깨졌음
+        return NULL;
+    }
+    STAT_INC(s, disk_hits);
+    atomic_store_explicit(&df.obj->expires, expires, memory_order_relaxed);
+    atomic_fetch_add_explicit(&df.obj->refs, 1, memory_order_relaxed);   // 호출자 몫
+    // 이 변경 전에 써 둔 레코드에는 태그가 있을 수 있음
+    const char *tags = NULL;
+    size_t tlen = 0;
+    obj_tags(df.obj, &tags, &tlen);
+    cache_link(s, key, h, df.obj, df.real, tags, tlen, 0, epoch, 0);
+    return df.obj;
+}
+
+// 메모리 계층을 통째로 비움
+static void flush_local(void) {
+    for (int i = 0; i < g_nshards; i++) {
+        CacheShard *s = &g_shards[i];
+        pthread_rwlock_wrlock(&s->rw);
+        for (size_t b = 0; b < s->nbuckets; b++)
+            while (s->buckets[b]) remove_entry(s, s->buckets[b], 0);
+        for (size_t b = 0; s->old && b < s->nold; b++)
+            while (s->old[b]) remove_entry(s, s->old[b], 0);
+        bump_epoch(s);   // 무효화 전에 공유 계층에서 읽어 아직 올리지 않은 것도
+        pthread_rwlock_unlock(&s->rw);
+    }
+}
+
+// 공유 세그먼트를 같이 쓰는 다른 프로세스가 무효화했으면 이 프로세스의 메모리 계층을 비움.
+// 어느 key 인지는 전하지 않음 (PURGE 는 드물고, 비워도 공유 계층에서 바로 다시 올라옴)
+static void sync_generation(void) {
+    if (!disk_shared()) return;
+    uint64_t g = disk_generation();
+    uint64_t seen = atomic_load_explicit(&g_gen_seen, memory_order_relaxed);
+    if (g != seen && atomic_compare_exchange_strong(&g_gen_seen, &seen, g)) flush_local();
+}
+
+// 이 프로세스의 무효화를 알림. 그 사이 다른 곳의 무효화가 없었으면 자신은 비울 필요 없음
+static void publish_invalidation(void) {
+    if (!disk_shared()) return;
+    uint64_t g = disk_invalidate(), prev = g - 1;
+    atomic_compare_exchange_strong(&g_gen_seen, &prev, g);
+}
+
+static CacheObj *lookup_tiers(CacheShard *s, const char *key, uint64_t h) {
+    sync_generation();
+    CacheObj *obj = lookup(s, key, h);
+    return obj ? obj : disk_promote(s, key, h);
+}
+
+CacheObj *get_cache(const char *key) {
+    cache_init(0, 0, 0);
+    uint64_t h = hash_key(key);
+    tinylfu_record(h);
+    return lookup_tiers(shard_of(h), key, h);
+}
+
+// 객체 자리 잡기. 예산은 할당기가 실제로 쓴 크기로 계산
+static CacheObj *obj_alloc(CacheShard *s, size_t n, size_t *real) {
+    if (n > g_max_object) return NULL;
+    CacheObj *obj = slab_alloc(sizeof(*obj) + n, real);
+    if (!obj) return NULL;
+    if (*real > s->budget) {
+        slab_free(obj, sizeof(*obj) + n);
+        return NULL;
+    }
+    atomic_init(&obj->refs, 1);   // 캐시가 가짐
+    obj->size = n;
+    atomic_init(&obj->expires, 0);
+    atomic_init(&obj->born, time(NULL));
+    atomic_init(&obj->hits, 0);
+    atomic_init(&obj->ahead, 0);
+    return obj;
+}
+
+/* 채운 객체를 캐시에 연결 (tags: Surrogate-Key 값, 없으면 NULL). 실패하면 객체 해제.
+  epoch 는 객체를 가져오기 시작할 때의 shard_epoch: 그 뒤 무효화가 있었으면 옛 내용일 수 있어 버리고,
+  on_disk (disk_store 가 썼음) 면 디스크 사본도 뺌 */
+static void cache_link(CacheShard *s, const char *key, uint64_t h, CacheObj *obj, size_t real,
+                       const char *tags, size_t tlen, int negative, uint64_t epoch, int on_disk) {
+    pthread_rwlock_wrlock(&s->rw);  
+
+    if (shard_epoch(s) != epoch) {
+        if (on_disk) disk_remove(key, h);
+        goto fail;
+    }
+
+    // 중복 키 있으면 삭제 후 넣기
+    // 이미 있던 key 의 교체는 입장 심사 없이 받음.
+    // negative 엔트리도 (작고 짧게 삶) 처음 본 key 라도 받아야 되풀이되는 미스를 바로 막음
+    // 정책 상태 (CAR 의 T2 등) 는 새 엔트리가 이어받음
+    Entry *dupe = find_entry(s, key, h);
+    int admitted = dupe || !g_admission || negative;
+    PolNode old, *prev = NULL;
+    if (dupe) {
+        old = dupe->pn;
+        prev = &old;
+        remove_entry(s, dupe, 0);
+    }
+
+    // 처음 내보낼 희생자보다 자주 쓰인 객체만 받음 (한 번 보고 마는 URL 이 작업 집합을 밀어내지 않게).
+    // 거절되면 정책 상태 (바늘, 참조 비트) 는 그대로 두도록 후보는 peek 으로만 봄
+    if (!admitted && s->bytes_used + real > s->budget) {
+        PolNode *cand = g_policy->peek(s->pol);
+        if (cand && !tinylfu_admit(h, cand->hash)) {
+            STAT_INC(s, rejected);
+            goto fail;
+        }
+    }
+
+    // 정책이 고른 희생자부터 제거
+    while (s->bytes_used + real > s->budget) {
+        Entry *victim = (Entry *)g_policy->victim(s->pol);
+        if (!victim) break;
+        remove_entry(s, victim, 1);
+    }
+
+    // 새 엔트리 생성
+    Entry *new_enty = (Entry *)calloc(1, sizeof(*new_enty));
+    if (!new_enty) goto fail;
+    new_enty->obj = obj;
+    new_enty->key = strdup(key);
+    new_enty->pn.size = real;
+    new_enty->pn.hash = h;
+    if (!new_enty->key || index_insert(s, new_enty) < 0) {
+        free(new_enty->key);
+        free(new_enty);
+        goto fail;
+    }
+    if ((tags && tags_attach(s, new_enty, tags, tlen) < 0) ||
+        g_policy->insert(s->pol, &new_enty->pn, prev) < 0) {
+        index_remove(s, new_enty);
+        free(new_enty->key);
+        free(new_enty);
+        goto fail;
+    }
+    s->bytes_used += real;
+    s->size_hist[size_bucket(obj->size)]++;
+    STAT_INC(s, inserts);
+
+    pthread_rwlock_unlock(&s->rw);
+    return;
+
+fail:
+    pthread_rwlock_unlock(&s->rw);
+    cache_release(obj);
+}
+
+// 디스크 계층에도 씀 (write-through). 태그 달린 객체와 negative 엔트리는 옛 사본만 지움
+// (태그 값은 *tags 로). 썼으면 1
+static int disk_store(const char *key, uint64_t h, CacheObj *obj, int negative,
+                      const char **tags, size_t *tlen) {
+    if (obj_tags(obj, tags, tlen) || negative) {
+        disk_remove(key, h);
+        return 0;
+    }
+    disk_put(key, h, obj->data, obj->size, atomic_load_explicit(&obj->expires, memory_order_relaxed));
+    return 1;
+}
+
+uint64_t cache_epoch(const char *key) {
+    cache_init(0, 0, 0);
+    return shard_epoch(shard_of(hash_key(key)));
+}
+
+// since 가 NULL 이면 지금의 세대로
+static void cache_put(const char *key, const char *blob, size_t n, time_t expires, int negative,
+                      const uint64_t *since) {
+    cache_init(0, 0, 0);
+    uint64_t h = hash_key(key);
+    CacheShard *s = shard_of(h);
+    uint64_t epoch = since ? *since : shard_epoch(s);
+
+    // 객체 복사는 락 밖에서
+    size_t real;
+    CacheObj *obj = obj_alloc(s, n, &real);
+    if (!obj) return;
+    memcpy(obj->data, blob, n);
+    atomic_store_explicit(&obj->expires, expires, memory_order_relaxed);
+    const char *tags = NULL;
+    size_t tlen = 0;
+    int on_disk = disk_store(key, h, obj, negative, &tags, &tlen);
+    cache_link(s, key, h, obj, real, tags, tlen, negative, epoch, on_disk);
+}
+
+void put_cache(const char *key, const char *blob, size_t n, time_t expires) {
+    cache_put(key, blob, n, expires, 0, NULL);
+}
+
+void put_cache_negative(const char *key, const char *blob, size_t n, time_t expires) {
+    cache_put(key, blob, n, expires, 1, NULL);
+}
+
+void put_cache_since(const char *key, const char *blob, size_t n, time_t expires, int negative,
+                     uint64_t epoch) {
+    cache_put(key, blob, n, expires, negative, &epoch);
+}
+
+int cache_purge(const char *key) {
+    cache_init(0, 0, 0);
+    sync_generation();
+    uint64_t h = hash_key(key);
+    CacheShard *s = shard_of(h);
+
+    pthread_rwlock_wrlock(&s->rw);
+    Entry *ent = find_entry(s, key, h);
+    if (ent) {
+        remove_entry(s, ent, 0);
+        STAT_INC(s, purged);
+    }
+    // 락 밖에서 이미 디스크 사본을 읽었거나 origin 에서 받는 중인 미스는 세대가 바뀌어
+    // cache_link 에서 버려짐. 그 뒤에 시작한 미스는 디스크에서도 못 찾음
+    int on_disk = disk_remove(key, h);
+    bump_epoch(s);
+    pthread_rwlock_unlock(&s->rw);
+    publish_invalidation();
+    return ent || on_disk;
+}
+
+// radix_prefix 콜백 안에서는 트리를 못 바꾸므로 일치한 엔트리를 모아 두었다가 지움
+typedef struct {
+    Entry **v;
+    size_t n, cap;
+} EntryList;
+
+static void collect_entry(void *arg, const char *key, size_t keylen, void *val) {
+    EntryList *el = arg;
+    (void)key;
+    (void)keylen;
+    if (el->n == el->cap) {
+        size_t cap = el->cap ? el->cap * 2 : 64;
+        Entry **v = realloc(el->v, cap * sizeof(*v));
+        if (!v) return;   // 못 모은 것은 이번에 안 지워짐
+        el->v = v;
+        el->cap = cap;
+    }
+    el->v[el->n++] = val;
+}
+
+size_t cache_purge_prefix(const char *prefix) {
+    cache_init(0, 0, 0);
+    sync_generation();
+    size_t plen = strlen(prefix), removed = 0;
+    EntryList el = {0};
+
+    for (int i = 0; i < g_nshards; i++) {
+        CacheShard *s = &g_shards[i];
+        el.n = 0;
+        pthread_rwlock_wrlock(&s->rw);
+        radix_prefix(&s->keys, prefix, plen, collect_entry, &el);
+        for (size_t k = 0; k < el.n; k++) {
+            // 디스크 락은 샤드 락 안에서만 잡히므로 (반대 순서 없음) 여기서 같이 빼도 됨
+            disk_remove(el.v[k]->key, el.v[k]->pn.hash);
+            remove_entry(s, el.v[k], 0);
+        }
+        atomic_fetch_add_explicit(&s->purged, el.n, memory_order_relaxed);
+        pthread_rwlock_unlock(&s->rw);
+        removed += el.n;
+    }
+
+    // 메모리에서는 이미 내보내고 디스크에만 남은 것들
+    removed += disk_remove_prefix(prefix);
+
+    // 위 두 단계 사이에 디스크에서 올라온 것은 빼고 (이미 센 것), 세대를 올려
+    // 디스크에서 읽었거나 origin 에서 받는 중인 미스가 넣지 못하게 함
+    for (int i = 0; i < g_nshards; i++) {
+        CacheShard *s = &g_shards[i];
+        el.n = 0;
+        pthread_rwlock_wrlock(&s->rw);
+        radix_prefix(&s->keys, prefix, plen, collect_entry, &el);
+        for (size_t k = 0; k < el.n; k++) remove_entry(s, el.v[k], 0);
+        bump_epoch(s);
+        pthread_rwlock_unlock(&s->rw);
+    }
+    free(el.v);
+    publish_invalidation();
+    return removed;
+}
+
+size_t cache_invalidate_tag(const char *tag) {
+    cache_init(0, 0, 0);
+    sync_generation();
+    size_t len = strlen(tag), removed = 0;
+    if (!len) return 0;
+
+    // 태그는 URL 과 상관없이 여러 샤드에 흩어짐. 샤드마다 목록 머리만 찾아서 비움
+    for (int i = 0; i < g_nshards; i++) {
+        CacheShard *s = &g_shards[i];
+        size_t n = 0;
+        TagRef *r;
+        pthread_rwlock_wrlock(&s->rw);
+        while ((r = radix_get(&s->tags, tag, len))) {
+            Entry *ent = r->ent;
+            disk_remove(ent->key, ent->pn.hash);   // 옛 형식 디스크 레코드에서 올라온 것일 수 있음
+            remove_entry(s, ent, 0);               // 목록에서도 빠짐
+            n++;
+        }
+        bump_epoch(s);
+        atomic_fetch_add_explicit(&s->purged, n, memory_order_relaxed);
+        pthread_rwlock_unlock(&s->rw);
+        removed += n;
+    }
+    publish_invalidation();   // 다른 프로세스의 메모리 계층에 있을 수 있음
+    return removed;
+}
+
+void cache_refresh(const char *key, CacheObj *obj, time_t expires) {
+    atomic_store_explicit(&obj->expires, expires, memory_order_relaxed);
+    // 새 수명 시작: 히트 수와 미리 갱신 표시도 다시
+    atomic_store_explicit(&obj->born, time(NULL), memory_order_relaxed);
+    atomic_store_explicit(&obj->hits, 0, memory_order_relaxed);
+    atomic_store_explicit(&obj->ahead, 0, memory_order_relaxed);
+    disk_refresh(key, hash_key(key), expires);
+}
+
+// 신선하면 히트로 셈 (미리 갱신 판단용)
+static int obj_fresh(CacheObj *obj) {
+    if (atomic_load_explicit(&obj->expires, memory_order_relaxed) <= time(NULL)) return 0;
+    atomic_fetch_add_explicit(&obj->hits, 1, memory_order_relaxed);
+    return 1;
+}
+
+static void flight_free_chunks(Flight *f) {
+    for (size_t i = 0; i < f->nchunks; i++) free(f->chunks[i]);
+    free(f->chunks);
+    f->chunks = NULL;
+    f->nchunks = f->chunk_cap = 0;
+}
+
+static void flight_unref(Flight *f) {
+    if (atomic_fetch_sub_explicit(&f->refs, 1, memory_order_acq_rel) != 1) return;
+    flight_free_chunks(f);
+    pthread_mutex_destroy(&f->mu);
+    pthread_cond_destroy(&f->cond);
+    free(f->key);
+    free(f);
+}
+
+// 목록에서 빼서 새 요청이 따라오지 못하게 함 (이미 따라온 요청은 계속 읽음)
+static void flight_unlist(Flight *f) {
+    CacheShard *s = f->shard;
+    pthread_mutex_lock(&s->fl_lock);
+    if (f->listed) {
+        Flight **pp = &s->flights;
+        while (*pp != f) pp = &(*pp)->next;
+        *pp = f->next;
+        f->listed = 0;
+    }
+    pthread_mutex_unlock(&s->fl_lock);
+}
+
+// mu 를 잡은 채로 호출. 깨울 비동기 대기자 목록을 떼어 냄
+static FlightWaiter *flight_signal(Flight *f) {
+    FlightWaiter *w = f->waiters;
+    f->waiters = NULL;
+    pthread_cond_broadcast(&f->cond);
+    return w;
+}
+
+// mu 밖에서. wake 안에서 다시 flight_read 가 불려 next 가 바뀔 수 있으니 먼저 읽음
+static void flight_wake_all(FlightWaiter *w) {
+    while (w) {
+        FlightWaiter *next = w->next;
+        w->wake(w);
+        w = next;
+    }
+}
+
+int flight_join(const char *key, Flight **out, CacheObj **hit) {
+    cache_init(0, 0, 0);
+    uint64_t h = hash_key(key);
+    CacheShard *s = shard_of(h);
+
+    *out = NULL;
+    tinylfu_record(h);
+    CacheObj *stale = lookup_tiers(s, key, h);
+    if (stale && obj_fresh(stale)) {
+        STAT_INC(s, hits);
+        *hit = stale;
+        return FLIGHT_HIT;
+    }
+    *hit = NULL;
+    if (stale) STAT_INC(s, stale);
+    else STAT_INC(s, misses);
+
+    pthread_mutex_lock(&s->fl_lock);
+    Flight *f;
+    for (f = s->flights; f; f = f->next)
+        if (f->hash == h && strcmp(f->key, key) == 0) break;
+    if (f) {
+        // 이미 누가 가져오는 중 -> 따라감
+        atomic_fetch_add_explicit(&f->refs, 1, memory_order_relaxed);
+        STAT_INC(s, coalesced);
+        pthread_mutex_unlock(&s->fl_lock);
+        *out = f;
+        *hit = stale;
+        return FLIGHT_FOLLOW;
+    }
+
+    // 락 잡기 직전에 리더가 끝내고 넣었을 수 있으니 한 번 더
+    CacheObj *again = lookup(s, key, h);
+    if (again && obj_fresh(again)) {
+        pthread_mutex_unlock(&s->fl_lock);
+        cache_release(stale);
+        *hit = again;
+        return FLIGHT_HIT;
+    }
+    if (again) {
+        cache_release(stale);
+        stale = again;
+    }
+
+    f = calloc(1, sizeof(*f));
+    if (f && !(f->key = strdup(key))) {
+        free(f);
+        f = NULL;
+    }
+    if (f) {
+        f->hash = h;
+        f->epoch = shard_epoch(s);   // origin 에 요청하기 전
+        f->shard = s;
+        atomic_init(&f->refs, 1);
+        pthread_mutex_init(&f->mu, NULL);
+        pthread_cond_init(&f->cond, NULL);
+        f->listed = 1;
+        f->next = s->flights;
+        s->flights = f;
+    }
+    pthread_mutex_unlock(&s->fl_lock);
+    *out = f;   // 할당 실패면 NULL: 혼자 가져옴
+    *hit = stale;
+    return FLIGHT_LEAD;
+}
+
+void flight_append(Flight *f, const char *data, size_t n) {
+    if (f->dropped || n == 0) return;
+
+    // 캐시에 못 넣을 크기: 저장은 포기하고 목록에서 빼서 새 요청은 따로 가져가게 함.
+    // 이미 보내기 시작한 요청은 끝까지 계속 받고, 아직 한 바이트도 안 읽은 요청은
+    // flight_read 가 실패를 돌려줘서 직접 가져감
+    if (!f->oversize && f->len + n > g_max_object) {
+        flight_unlist(f);
+        pthread_mutex_lock(&f->mu);
+        f->oversize = 1;
+        FlightWaiter *w = flight_signal(f);
+        pthread_mutex_unlock(&f->mu);
+        flight_wake_all(w);
+    }
+    // 읽던 요청이 다 떠나면 그만 쌓음. 새로 따라올 수 없으니 남은 참조가 리더뿐이면
+    // 조각을 쓰는 쪽도 없음
+    if (f->oversize && atomic_load_explicit(&f->refs, memory_order_acquire) == 1) {
+        pthread_mutex_lock(&f->mu);
+        f->dropped = 1;
+        flight_free_chunks(f);
+        pthread_mutex_unlock(&f->mu);
+        return;
+    }
+
+    /* 쓰는 쪽은 리더 하나뿐이라 [len, 조각 끝) 에는 락 없이 복사하고
+       조각 목록과 len 만 락 안에서 바꿈 */
+    while (n > 0) {
+        size_t used = f->len % FLIGHT_CHUNK;
+        char *chunk = NULL;
+        if (used == 0) {
+            if (!(chunk = malloc(FLIGHT_CHUNK))) goto oom;
+        } else {
+            chunk = f->chunks[f->nchunks - 1];
+        }
+        size_t take = FLIGHT_CHUNK - used;
+        if (take > n) take = n;
+        memcpy(chunk + used, data, take);
+
+        pthread_mutex_lock(&f->mu);
+        if (used == 0) {
+            if (f->nchunks == f->chunk_cap) {
+                size_t cap = f->chunk_cap ? f->chunk_cap * 2 : 8;
+                char **p = realloc(f->chunks, cap * sizeof(*p));
+                if (!p) {
+                    pthread_mutex_unlock(&f->mu);
+                    free(chunk);
+                    goto oom;
+                }
+                f->chunks = p;
+                f->chunk_cap = cap;
+            }
+            f->chunks[f->nchunks++] = chunk;
+        }
+        f->len += take;
+        FlightWaiter *w = flight_signal(f);
+        pthread_mutex_unlock(&f->mu);
+        flight_wake_all(w);
+
+        data += take;
+        n -= take;
+    }
+    return;
+
+oom:
+    // 더 쌓을 수 없으면 따라온 요청들에게는 실패로 보임
+    flight_unlist(f);
+    pthread_mutex_lock(&f->mu);
+    f->failed = f->dropped = 1;
+    FlightWaiter *w = flight_signal(f);
+    pthread_mutex_unlock(&f->mu);
+    flight_wake_all(w);
+}
+
+void flight_finish(Flight *f, int how, time_t expires) {
+    CacheShard *s = f->shard;
+
+    // 다 받았고 크기가 맞으면 조각들을 이어 붙여 캐시에 넣음
+    if ((how == FLIGHT_STORE || how == FLIGHT_STORE_NEG) && !f->dropped && !f->oversize) {
+        size_t real;
+        CacheObj *obj = obj_alloc(s, f->len, &real);
+        if (obj) {
+            for (size_t off = 0, i = 0; off < f->len; off += FLIGHT_CHUNK, i++) {
+                size_t n = f->len - off < FLIGHT_CHUNK ? f->len - off : FLIGHT_CHUNK;
+                memcpy(obj->data + off, f->chunks[i], n);
+            }
+            atomic_store_explicit(&obj->expires, expires, memory_order_relaxed);
+            const char *tags = NULL;
+            size_t tlen = 0;
+            int neg = how == FLIGHT_STORE_NEG;
+            int on_disk = disk_store(f->key, f->hash, obj, neg, &tags, &tlen);
+            cache_link(s, f->key, f->hash, obj, real, tags, tlen, neg, f->epoch, on_disk);
+        }
+    }
+    // 캐시에 들어간 뒤에 목록에서 빼야 그 사이 요청이 미스로 새 fetch 를 시작하지 않음
+    flight_unlist(f);
+
+    pthread_mutex_lock(&f->mu);
+    f->done = 1;
+    if (how == FLIGHT_FAIL) f->failed = 1;
+    FlightWaiter *w = flight_signal(f);
+    pthread_mutex_unlock(&f->mu);
+    flight_wake_all(w);
+
+    flight_unref(f);
+}
+
+void flight_hold(Flight *f) {
+    atomic_fetch_add_explicit(&f->refs, 1, memory_order_relaxed);
+}
+
+long flight_read(Flight *f, size_t off, const char **p, FlightWaiter *w) {
+    long n;
+
+    pthread_mutex_lock(&f->mu);
+    while (off >= f->len && !f->done && !f->failed) {
+        if (w) {
+            w->next = f->waiters;
+            f->waiters = w;
+            pthread_mutex_unlock(&f->mu);
+            return FLIGHT_AGAIN;
+        }
+        pthread_cond_wait(&f->cond, &f->mu);
+    }
+    if (f->failed || (f->oversize && off == 0)) {
+        n = FLIGHT_ERR;
+    } else if (off >= f->len) {
+        n = 0;
+    } else {
+        // 조각 경계까지만. 조각은 flight 가 살아 있는 동안 그대로
+        size_t in = off % FLIGHT_CHUNK;
+        *p = f->chunks[off / FLIGHT_CHUNK] + in;
+        n = (long)(f->len - off < FLIGHT_CHUNK - in ? f->len - off : FLIGHT_CHUNK - in);
+    }
+    pthread_mutex_unlock(&f->mu);
+    return n;
+}
+
+void flight_leave(Flight *f) {
+    flight_unref(f);
+}
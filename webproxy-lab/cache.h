@@ -0,0 +1,157 @@
+/*
+ * cache.h - 프록시 웹 객체 캐시
+ *
+ * key (host:port/path) 해시로 고른 샤드마다 rwlock, 해시 인덱스,
+ * 교체 정책 상태 (기본 CLOCK), 바이트 예산을 따로 가짐 -> 다른 샤드끼리는 락 경쟁이 없음.
+ * 예산이 차면 TinyLFU 빈도 스케치로 새 객체와 희생자를 비교해서 받을지 정함.
+ * disk_open 으로 디스크 계층을 켜면 넣는 객체를 디스크에도 쓰고, 메모리 미스는 디스크에서 올림
+ */
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Recommended max cache and object sizes (기본값, cache_init 으로 바꿀 수 있음) */
+#define MAX_CACHE_SIZE 1049000
+#define MAX_OBJECT_SIZE 102400
+
+#define CACHE_DEFAULT_SHARDS 8
+
+/* 캐시된 응답 (헤더+바디). 넣은 뒤로는 내용이 바뀌지 않음 (재검증 때 expires 만 갱신).
+   캐시와 히트한 요청들이 참조를 나눠 갖고, 마지막 참조가 놓일 때 해제됨 */
+typedef struct {
+    _Atomic int refs;
+    _Atomic time_t expires;   /* 이 시각 (time()) 부터는 재검증 필요 */
+    _Atomic time_t born;      /* 지금 수명의 시작 (넣은 / 마지막으로 재검증된 시각) */
+    _Atomic unsigned hits;    /* born 이후 신선한 히트 수 */
+    _Atomic int ahead;        /* 이번 수명에 미리 갱신을 이미 맡김 */
+    size_t size;
+    char data[];
+} CacheObj;
+
+/* 전체 예산, 객체 하나 상한, 샤드 수 설정 (0 이면 기본값).
+   샤드 예산이 객체 상한보다 작아지지 않게 샤드 수를 줄여서 적용.
+   get/put 전에 한 번 호출 (안 하면 첫 사용 때 기본값으로) */
+void cache_init(size_t capacity, size_t max_object, int nshards);
+int cache_nshards(void);
+size_t cache_capacity(void);
+size_t cache_max_object(void);
+
+/* 자리가 모자랄 때 새 객체를 희생자와 빈도로 비교해서 받을지 정함 (TinyLFU, 기본 켜짐).
+   0 이면 예전처럼 모두 받음 */
+void cache_set_admission(int on);
+
+/* 교체 정책 고르기 ("clock", "gdsf", "car", policy.h 참고). cache_init 전에만, 모르는 이름이면 -1 */
+int cache_set_policy(const char *name);
+const char *cache_policy(void);
+const char *cache_policy_names(void);   /* 사용법 출력용 "clock|gdsf|car" */
+
+/* 통계 스냅샷. 카운터는 샤드마다 relaxed atomic 이라 요청 경로에 락을 더하지 않음.
+   hits/stale/misses/coalesced 는 요청 경로 (flight_join) 기준 */
+#define CACHE_SIZE_BUCKETS 12   /* size_hist[i]: 크기 (1K << i) 미만, 마지막 칸은 나머지 */
+typedef struct {
+    unsigned long hits;         /* 신선한 히트 */
+    unsigned long stale;        /* 있지만 만료됨 (재검증 / stale 응답) */
+    unsigned long misses;
+    unsigned long disk_hits;    /* 메모리 미스를 디스크 계층에서 올림 */
+    unsigned long coalesced;    /* 진행 중 fetch 를 따라 읽음 */
+    unsigned long inserts, evictions;
+    unsigned long rejected;     /* 입장 심사 (TinyLFU) 에서 거절 */
+    unsigned long purged;       /* PURGE 로 뺌 (메모리) */
+    size_t capacity, bytes_used, entries;
+    size_t size_hist[CACHE_SIZE_BUCKETS];
+} CacheStats;
+void cache_stats(CacheStats *st);
+
+/* 미리 갱신 (refresh-ahead): 수명의 frac (0~1) 이 지났고 그동안 min_hits 번 이상 히트한
+   객체는 만료 전에 다시 받아서 갈아 끼움. frac 0 이면 끔 (기본) */
+void cache_set_refresh_ahead(double frac, unsigned min_hits);
+/* FLIGHT_HIT 로 받은 객체를 지금 미리 갱신해야 하면 1. 수명마다 한 번만 1 (재검증되면 다시) */
+int cache_ahead_due(CacheObj *obj);
+
+/* 히트면 참조를 하나 잡은 객체, 아니면 NULL (신선도는 보지 않음). 다 쓰면 cache_release */
+CacheObj *get_cache(const char *key);
+void cache_release(CacheObj *obj);
+void cache_retain(CacheObj *obj);   /* 이미 잡은 참조를 하나 더 (다른 스레드에 넘길 때) */
+void put_cache(const char *key, const char *blob, size_t n, time_t expires);
+/* 404/410 이나 닿지 않는 origin 표시처럼 짧게만 두는 응답. 입장 심사 없이 받고 디스크에는 안 씀 */
+void put_cache_negative(const char *key, const char *blob, size_t n, time_t expires);
+/* key 가 속한 샤드의 무효화 세대. origin 에 요청하기 전에 받아 put_cache_since 에 넘기면
+   그 사이 PURGE / 태그 무효화가 있었을 때 (옛 내용일 수 있으니) 저장하지 않음 */
+uint64_t cache_epoch(const char *key);
+void put_cache_since(const char *key, const char *blob, size_t n, time_t expires, int negative,
+                     uint64_t epoch);
+
+/* 무효화 (PURGE). 메모리와 디스크 계층에서 모두 뺌 (이미 받아 간 요청은 끝까지 읽음).
+   디스크 계층이 공유 메모리면 같이 쓰는 다른 프로세스는 다음 조회 때 메모리 계층을 통째로 비움.
+   무효화 전에 시작한 미스 (디스크에서 읽었거나 origin 에서 받는 중) 는 캐시에 넣지 않음.
+   cache_purge 는 있었으면 1. cache_purge_prefix 는 prefix 로 시작하는 key 를 모두 빼고 그 수:
+   샤드마다 key radix tree 의 일치하는 부분 트리만 훑으므로 전체 엔트리 수와 무관 */
+int cache_purge(const char *key);
+size_t cache_purge_prefix(const char *prefix);
+
+/* Surrogate-Key 태그 무효화. 저장할 때 응답의 Surrogate-Key 태그마다 샤드별
+   태그 -> 엔트리 역색인에 걸어 두고, 태그 하나로 걸린 엔트리를 모두 빼서 그 수.
+   URL 을 몰라도 되고 비용은 (샤드 수 + 걸린 엔트리 수).
+   태그 달린 응답은 디스크 계층에 쓰지 않음 (디스크만 남은 사본은 태그로 못 찾으므로) */
+size_t cache_invalidate_tag(const char *tag);
+
+/* 304 로 재검증된 객체의 만료 시각만 늘림 (디스크 계층 레코드도) */
+void cache_refresh(const char *key, CacheObj *obj, time_t expires);
+
+/* single-flight + 스트리밍 채우기
+   같은 key 의 미스가 동시에 여러 번 와도 업스트림 fetch 는 하나(리더)만.
+   리더가 받는 대로 flight 에 덧붙이고, 따라온 요청들은 채워지는 버퍼를
+   자기 속도로 읽어 감 (아직 안 온 바이트에서만 기다림).
+   다 받으면 리더가 캐시에 넣음 */
+typedef struct Flight Flight;
+
+/* 이벤트 루프처럼 블록하면 안 되는 읽기용. 새 바이트가 오거나 끝나면
+   wake 가 (리더 스레드에서) 한 번 불림. 계속 받으려면 다시 flight_read */
+typedef struct FlightWaiter {
+    void (*wake)(struct FlightWaiter *w);
+    struct FlightWaiter *next;
+} FlightWaiter;
+
+enum {
+    FLIGHT_HIT,      /* 신선한 캐시 히트, *hit 에 객체 */
+    FLIGHT_LEAD,     /* 내가 리더: flight_append 후 flight_finish 필수 (*f 가 NULL 이면 혼자 가져오면 됨).
+                        만료된 객체가 있으면 *hit 에 (재검증용), 없으면 NULL */
+    FLIGHT_FOLLOW    /* 이미 가져오는 중: flight_read 로 읽고 flight_leave.
+                        만료된 객체가 있으면 *hit 에 (stale 로 바로 응답할 수 있게), 없으면 NULL */
+};
+
+int flight_join(const char *key, Flight **f, CacheObj **hit);
+
+/* 리더 전용. 받은 조각을 덧붙이고 읽는 쪽을 깨움.
+   객체 상한을 넘으면 저장은 포기하되 이미 읽기 시작한 요청에게는 끝까지 이어서 보냄 */
+void flight_append(Flight *f, const char *data, size_t n);
+
+/* flight_finish 결과 */
+enum {
+    FLIGHT_FAIL,     /* 실패 (또는 공유하면 안 되는 응답): 따라온 요청은 직접 가져옴 */
+    FLIGHT_NOSTORE,  /* 정상 완료, 캐시에는 넣지 않음 */
+    FLIGHT_STORE,    /* 정상 완료, expires 로 캐시에 넣음 (크기가 맞을 때) */
+    FLIGHT_STORE_NEG /* FLIGHT_STORE 와 같되 negative 엔트리로 (put_cache_negative 처럼) */
+};
+
+/* 리더 전용. 따라온 요청들에게 끝을 알리고 리더의 참조도 놓음 */
+void flight_finish(Flight *f, int how, time_t expires);
+
+#define FLIGHT_ERR   (-1)   /* 리더가 실패: 응답이 중간에 끊김 (off 0 이면 상한을 넘은 응답일 수도 -> 직접 가져옴) */
+#define FLIGHT_AGAIN (-2)   /* w 를 준 경우 아직 새 바이트가 없음 -> wake 후 다시 */
+
+/* off 부터 읽을 수 있는 연속 구간을 *p 로 (길이 반환, 0 이면 끝).
+   w 가 NULL 이면 새 바이트가 올 때까지 블록 */
+long flight_read(Flight *f, size_t off, const char **p, FlightWaiter *w);
+
+/* 따라온 요청이 다 읽었거나 그만둘 때 */
+void flight_leave(Flight *f);
+
+/* 리더가 자기 몫을 넘기면서 (재검증 스레드 등) 자신은 따라온 요청처럼 계속 읽을 때.
+   참조를 하나 더 잡음 -> flight_read 로 읽고 flight_leave */
+void flight_hold(Flight *f);
+
+#endif /* __CACHE_H__ */
@@ -0,0 +1,110 @@
+/*
+ * cachebench.c - 캐시 히트 처리량 벤치마크
+ *
+ *   usage: ./cachebench [-n shards] [-t max_threads] [-k keys] [-b obj_bytes] [-d ms]
+ *
+ * keys 개의 작은 객체를 미리 넣어두고, 스레드 1, 2, 4, ... max_threads 개로
+ * 각각 d ms 동안 무작위 key 로 get_cache 만 반복해서 초당 히트 수를 출력함.
+ * -n 1 과 -n 8 등을 비교하면 샤드별 락 분리 효과를 볼 수 있음
+ */
+#include "cache.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int g_keys = 1000;
+static char **g_keynames;
+static atomic_int g_stop;
+
+typedef struct {
+    unsigned seed;
+    unsigned long hits;
+} Worker;
+
+static void *bench_worker(void *arg) {
+    Worker *w = arg;
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        int k = rand_r(&w->seed) % g_keys;
+        CacheObj *obj = get_cache(g_keynames[k]);
+        if (obj) {
+            cache_release(obj);
+            w->hits++;
+        }
+    }
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int nshards = CACHE_DEFAULT_SHARDS, max_threads = 8, obj = 512, ms = 500;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:k:b:d:")) != -1) {
+        switch (opt) {
+        case 'n': nshards = atoi(optarg); break;
+        case 't': max_threads = atoi(optarg); break;
+        case 'k': g_keys = atoi(optarg); break;
+        case 'b': obj = atoi(optarg); break;
+        case 'd': ms = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n shards] [-t max_threads] [-k keys] [-b obj_bytes] [-d ms]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    if (g_keys <= 0 || obj <= 0 || max_threads <= 0 || ms <= 0) exit(1);
+
+    cache_init(0, 0, nshards);
+
+    // 전부 캐시에 들어가도록 예산 안에서만 채움
+    size_t cap = cache_capacity();
+    if ((size_t)g_keys * obj > cap / 2) g_keys = (int)(cap / 2 / obj);
+    char *blob = malloc(obj);
+    memset(blob, 'x', obj);
+    g_keynames = calloc(g_keys, sizeof(char *));
+    for (int i = 0; i < g_keys; i++) {
+        char key[64];
+        snprintf(key, sizeof(key), "bench.local:80/obj/%d", i);
+        g_keynames[i] = strdup(key);
+        put_cache(key, blob, obj, time(NULL) + 3600);
+    }
+
+    printf("shards=%d keys=%d obj=%dB\n", cache_nshards(), g_keys, obj);
+    printf("%8s %14s %10s\n", "threads", "hits/s", "scale");
+
+    double base = 0;
+    for (int t = 1; t <= max_threads; t *= 2) {
+        pthread_t *tids = calloc(t, sizeof(pthread_t));
+        Worker *ws = calloc(t, sizeof(Worker));
+        atomic_store(&g_stop, 0);
+
+        double start = now_sec();
+        for (int i = 0; i < t; i++) {
+            ws[i].seed = 12345u + i;
+            pthread_create(&tids[i], NULL, bench_worker, &ws[i]);
+        }
+        usleep(ms * 1000);
+        atomic_store(&g_stop, 1);
+        unsigned long hits = 0;
+        for (int i = 0; i < t; i++) {
+            pthread_join(tids[i], NULL);
+            hits += ws[i].hits;
+        }
+        double rate = hits / (now_sec() - start);
+        if (t == 1) base = rate;
+        printf("%8d %14.0f %9.2fx\n", t, rate, rate / base);
+
+        free(tids);
+        free(ws);
+    }
+    return 0;
+}
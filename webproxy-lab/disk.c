@@ -0,0 +1,498 @@
+/*
+ * disk.c - mmap 파일 2단 캐시 (disk.h 참고)
+ *
+ * 파일 배치
+ *   [DiskHdr (4KB)] [DiskSlot x nslots] [로그: DiskRec + key + data 가 8바이트 정렬로 이어짐]
+ * 쓰기는 head 에, 지울 차례인 가장 오래된 레코드는 evict 에 있음 (evict >= head).
+ * 새 레코드가 덮을 구간의 옛 레코드들은 먼저 인덱스에서 빼고 씀.
+ * 로그 끝에 못 들어가면 END 표시를 남기고 처음으로 돌아감.
+ * 락은 헤더 안의 robust + 프로세스 공유 mutex: 잡은 프로세스가 죽어도 다음 사람이 이어 받음
+ * (레코드는 다 쓴 뒤에 인덱스에 올리고 읽을 때 체크섬을 보므로 반쯤 쓴 것은 걸러짐)
+ *
+ * 락은 로그 자리 잡기와 인덱스 갱신에만 잡음. 복사와 체크섬은 락 밖에서:
+ *   쓰기: 락 안에서 자리를 잡고 REC_BUSY 머리만 씀 -> 락 밖에서 key/본문 복사
+ *         -> 다시 락 잡고 그 사이 덮이지 않았으면 REC_MAGIC 으로 바꾸고 인덱스에 올림
+ *   읽기: 락 안에서 위치만 알아냄 -> 락 밖에서 복사, 체크섬 -> reserved 로 그 사이
+ *         로그가 한 바퀴 돌아 덮였는지 확인 (seqlock 처럼)
+ * 위치는 바퀴 수까지 센 논리 위치 (lap * log_size + off). 논리 위치 P 에서 시작한 레코드는
+ * 자리 잡기가 P + log_size 를 넘을 때 처음 덮임
+ */
+#include "disk.h"
+#include "radix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DISK_MAGIC  0x32534b4944585250ULL   // "PRXDISK2"
+#define REC_MAGIC   0x31434552u             // "REC1"
+#define REC_END     0x31444e45u             // "END1": 이 뒤로는 로그 끝까지 빈 곳
+#define REC_BUSY    0x31595342u             // "BSY1": 자리만 잡고 아직 쓰는 중
+#define HDR_SIZE    4096
+#define AVG_OBJECT  2048     // 인덱스 크기 잡을 때 가정하는 평균 레코드 크기
+#define MAX_PROBE   128      // 인덱스가 이만큼 차 있으면 그 객체는 디스크에 안 넣음
+#define SCAN_BATCH  4096     // 공유 모드 prefix 삭제가 락을 한 번 잡고 훑는 슬롯 수
+#define BUSY_TIMEOUT 10      // 이보다 오래 쓰는 중인 레코드는 쓰던 프로세스가 죽은 것으로 (초)
+
+typedef struct {
+    uint64_t magic;
+    uint64_t file_size;
+    uint64_t nslots;
+    uint64_t log_off, log_size;
+    uint64_t head;       // 다음 쓰기 위치 (로그 기준)
+    uint64_t evict;      // 가장 오래된 레코드 위치, 없으면 log_size
+    uint64_t lap;        // head 가 처음으로 돌아간 횟수
+    _Alignas(64) pthread_mutex_t lock;       // 위 전부와 인덱스, 로그 머리 보호
+    _Alignas(64) _Atomic uint64_t gen;       // 무효화 세대 (조회마다 읽으므로 락과 다른 줄)
+    _Atomic uint64_t reserved;               // 지금까지 잡은 자리의 끝 (논리 위치). 락 안에서만 올림
+} DiskHdr;
+
+typedef struct {
+    uint64_t hash;       // 0 이 아닌 값 (0 은 빈 슬롯)
+    uint64_t off;        // 레코드 위치 (로그 기준)
+} DiskSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t keylen;
+    uint64_t datalen;
+    uint64_t hash;
+    uint64_t sum;        // 본문 체크섬 (재시작 후 찢어진 레코드 거르기)
+    uint64_t pos;        // 논리 위치 (덮였는지 확인용)
+    int64_t expires;
+} DiskRec;               // 뒤에 key (NUL 없음), data
+
+static DiskHdr *g_hdr;
+static DiskSlot *g_slots;
+static char *g_log;
+static uint64_t g_mask;
+static int g_shared;   // 공유 메모리 세그먼트 (g_keys 는 안 씀)
+static Radix g_keys;   // 인덱스에 있는 key -> 해시 (prefix 삭제용, 메모리에만. 열 때 다시 만듦)
+
+static void disk_lock(void) {
+    if (pthread_mutex_lock(&g_hdr->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&g_hdr->lock);   // 잡고 있던 프로세스가 죽음
+}
+
+static void disk_unlock(void) {
+    pthread_mutex_unlock(&g_hdr->lock);
+}
+
+static void lock_init(pthread_mutex_t *m) {
+    pthread_mutexattr_t at;
+    pthread_mutexattr_init(&at);
+    pthread_mutexattr_setpshared(&at, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&at, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(m, &at);
+    pthread_mutexattr_destroy(&at);
+}
+
+static int keys_insert(const char *key, size_t keylen, uint64_t hash) {
+    return g_shared ? 0 : radix_insert(&g_keys, key, keylen, (void *)(uintptr_t)hash);
+}
+
+static uint64_t slot_hash(uint64_t h) {
+    return h ? h : 1;
+}
+
+static uint64_t checksum(const char *p, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    while (n--) {
+        h ^= (unsigned char)*p++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t rec_len(uint64_t keylen, uint64_t datalen) {
+    return (sizeof(DiskRec) + keylen + datalen + 7) & ~7ULL;
+}
+
+static DiskRec *rec_at(uint64_t off) {
+    return (DiskRec *)(g_log + off);
+}
+
+// off 의 레코드가 key 의 온전한 레코드인가
+static int rec_matches(uint64_t off, const char *key, size_t keylen, uint64_t h) {
+    if (off + sizeof(DiskRec) > g_hdr->log_size) return 0;
+    DiskRec *r = rec_at(off);
+    return r->magic == REC_MAGIC && r->hash == h && r->keylen == keylen &&
+           off + rec_len(r->keylen, r->datalen) <= g_hdr->log_size &&
+           memcmp((char *)(r + 1), key, keylen) == 0;
+}
+
+static long slot_find(const char *key, uint64_t h) {
+    size_t keylen = strlen(key);
+    uint64_t sh = slot_hash(h);
+    for (uint64_t i = sh & g_mask, n = 0; g_slots[i].hash && n < MAX_PROBE; i = (i + 1) & g_mask, n++)
+        if (g_slots[i].hash == sh && rec_matches(g_slots[i].off, key, keylen, h)) return (long)i;
+    return -1;
+}
+
+// 선형 탐사용 삭제: 빈 칸을 만들지 않고 뒤의 항목들을 당겨 채움 (묘비 없음)
+static void slot_delete(uint64_t i) {
+    uint64_t j = i;
+    while (1) {
+        j = (j + 1) & g_mask;
+        if (!g_slots[j].hash) break;
+        uint64_t k = g_slots[j].hash & g_mask;   // j 의 원래 자리
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+        g_slots[i] = g_slots[j];
+        i = j;
+    }
+    g_slots[i].hash = 0;
+}
+
+// 슬롯과 key 목록에서 같이 뺌
+static void slot_forget(uint64_t i) {
+    DiskRec *r = rec_at(g_slots[i].off);
+    if (!g_shared) radix_remove(&g_keys, (char *)(r + 1), r->keylen);
+    slot_delete(i);
+}
+
+static void slot_delete_off(uint64_t h, uint64_t off) {
+    uint64_t sh = slot_hash(h);
+    for (uint64_t i = sh & g_mask, n = 0; g_slots[i].hash && n < MAX_PROBE; i = (i + 1) & g_mask, n++) {
+        if (g_slots[i].hash == sh && g_slots[i].off == off) {
+            slot_forget(i);
+            return;
+        }
+    }
+}
+
+// [evict, limit) 에 걸친 옛 레코드들을 인덱스에서 뺌.
+// 아직 복사 중인 레코드에 닿으면 거기서 멈추고 -1 (덮으면 늦게 끝난 복사가 새 레코드를 망침)
+static int evict_until(uint64_t limit) {
+    DiskHdr *d = g_hdr;
+    time_t now = 0;
+    while (d->evict < limit) {
+        if (d->evict + sizeof(DiskRec) > d->log_size) {
+            d->evict = d->log_size;
+            break;
+        }
+        DiskRec *r = rec_at(d->evict);
+        if (r->magic != REC_MAGIC && r->magic != REC_BUSY) {
+            d->evict = d->log_size;   // END 표시나 한 번도 안 쓴 곳
+            break;
+        }
+        if (r->magic == REC_BUSY) {
+            if (!now) now = time(NULL);
+            if (now - (time_t)r->expires < BUSY_TIMEOUT) return -1;
+        }
+        uint64_t len = rec_len(r->keylen, r->datalen);
+        if (d->evict + len > d->log_size) {
+            d->evict = d->log_size;   // 머리가 깨짐: 여기서부터 빈 곳으로
+            break;
+        }
+        slot_delete_off(r->hash, d->evict);
+        d->evict += len;
+    }
+    return 0;
+}
+
+// 새 파일이거나 설정이 바뀐 파일: 헤더/인덱스를 비움
+static void disk_format(size_t size) {
+    uint64_t nslots = 64;
+    while (nslots < size / AVG_OBJECT) nslots <<= 1;
+    while (HDR_SIZE + nslots * sizeof(DiskSlot) > size / 4) nslots >>= 1;
+
+    radix_free(&g_keys);
+    memset(g_hdr, 0, HDR_SIZE);
+    g_hdr->file_size = size;
+    g_hdr->nslots = nslots;
+    g_hdr->log_off = HDR_SIZE + nslots * sizeof(DiskSlot);
+    g_hdr->log_size = (size - g_hdr->log_off) & ~7ULL;
+    g_hdr->head = 0;
+    g_hdr->evict = g_hdr->log_size;
+    memset((char *)g_hdr + HDR_SIZE, 0, nslots * sizeof(DiskSlot));
+    memset((char *)g_hdr + g_hdr->log_off, 0, sizeof(DiskRec));
+    lock_init(&g_hdr->lock);
+    g_hdr->magic = DISK_MAGIC;   // 마지막에 써야 중간에 죽어도 다음에 다시 포맷
+}
+
+// 재시작: 인덱스에 남은 레코드들의 key 목록을 다시 만듦. 깨진 슬롯은 버림
+static void keys_rebuild(void) {
+    for (uint64_t i = 0; i < g_hdr->nslots; ) {
+        if (!g_slots[i].hash) {
+            i++;
+            continue;
+        }
+        uint64_t off = g_slots[i].off;
+        DiskRec *r = rec_at(off);
+        if (off + sizeof(DiskRec) > g_hdr->log_size || r->magic != REC_MAGIC ||
+            off + rec_len(r->keylen, r->datalen) > g_hdr->log_size ||
+            keys_insert((char *)(r + 1), r->keylen, r->hash) < 0) {
+            slot_delete(i);   // 뒤의 항목이 당겨져 올 수 있으니 i 는 그대로
+            continue;
+        }
+        i++;
+    }
+}
+
+// fd 를 size 로 맞춰 mmap 하고 헤더 확인 (처음이거나 크기가 다르면 포맷).
+// 파일은 이 프로세스만 여는 것이라 옛 락 상태는 버림. 공유 세그먼트는 flock 으로 포맷을 한 번만
+static int disk_map(int fd, size_t size, int shared) {
+    if (size < 1024 * 1024) return -1;
+    if (shared && flock(fd, LOCK_EX) < 0) return -1;
+
+    // 쓰는 중인 세그먼트의 크기를 바꾸면 다른 프로세스의 매핑이 깨지므로 공유는 같은 크기만
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && ((size_t)st.st_size == size ||
+                                ((!shared || !st.st_size) && ftruncate(fd, (off_t)size) == 0)))
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+        g_hdr = p;
+        g_shared = shared;
+        if (g_hdr->magic != DISK_MAGIC || g_hdr->file_size != size) disk_format(size);
+        else if (!shared) lock_init(&g_hdr->lock);
+        g_slots = (DiskSlot *)((char *)p + HDR_SIZE);
+        g_log = (char *)p + g_hdr->log_off;
+        g_mask = g_hdr->nslots - 1;
+        disk_lock();
+        keys_rebuild();
+        disk_unlock();
+    }
+    if (shared) flock(fd, LOCK_UN);
+    close(fd);
+    return p == MAP_FAILED ? -1 : 0;
+}
+
+int disk_open(const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    return fd < 0 ? -1 : disk_map(fd, size, 0);
+}
+
+int disk_open_shared(const char *name, size_t size) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    return fd < 0 ? -1 : disk_map(fd, size, 1);
+}
+
+int disk_shared(void) {
+    return g_shared;
+}
+
+uint64_t disk_generation(void) {
+    return g_hdr ? atomic_load_explicit(&g_hdr->gen, memory_order_acquire) : 0;
+}
+
+uint64_t disk_invalidate(void) {
+    return g_hdr ? atomic_fetch_add_explicit(&g_hdr->gen, 1, memory_order_acq_rel) + 1 : 0;
+}
+
+int disk_enabled(void) {
+    return g_hdr != NULL;
+}
+
+// 논리 위치 pos 에서 시작한 레코드가 그 뒤 잡힌 자리에 덮였는가 (락 없이 봄)
+static int rec_clobbered(uint64_t pos) {
+    return atomic_load_explicit(&g_hdr->reserved, memory_order_relaxed) > pos + g_hdr->log_size;
+}
+
+void *disk_get(const char *key, uint64_t hash, time_t *expires,
+               void *(*alloc)(void *arg, size_t n), void *arg) {
+    if (!g_hdr) return NULL;
+
+    // 락 안에서는 위치와 머리만 읽음
+    disk_lock();
+    long i = slot_find(key, hash);
+    if (i < 0) {
+        disk_unlock();
+        return NULL;
+    }
+    uint64_t off = g_slots[i].off;
+    DiskRec *r = rec_at(off);
+    uint64_t pos = r->pos, n = r->datalen, sum = r->sum;
+    time_t exp = (time_t)r->expires;
+    const char *data = (char *)(r + 1) + r->keylen;
+    disk_unlock();
+
+    void *dst = alloc(arg, n);
+    if (!dst) return NULL;
+    memcpy(dst, data, n);
+    atomic_thread_fence(memory_order_acquire);   // 복사가 reserved 읽기보다 먼저
+    if (rec_clobbered(pos)) return NULL;         // 복사하는 사이 덮임
+    if (checksum(dst, n) != sum) {
+        // 찢어진 레코드
+        disk_lock();
+        if (!rec_clobbered(pos)) slot_delete_off(hash, off);
+        disk_unlock();
+        return NULL;
+    }
+    *expires = exp;
+    return dst;
+}
+
+/* 락 안에서, 로그 논리 위치 end 까지 덮어쓰기 직전에. 덮을 레코드를 다 비운 뒤에만 불러야 함:
+  포기한 자리 잡기가 올리면 아직 쓰는 중인 레코드가 덮인 것으로 보여 REC_BUSY 로 남음 */
+static void log_reserve(uint64_t end) {
+    if (end > atomic_load_explicit(&g_hdr->reserved, memory_order_relaxed))
+        atomic_store_explicit(&g_hdr->reserved, end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);   // 덮어쓰기보다 먼저 보이게 (그 자리를 복사하던 읽기가 알아챔)
+}
+
+void disk_put(const char *key, uint64_t hash, const char *data, size_t n, time_t expires) {
+    if (!g_hdr) return;
+    size_t keylen = strlen(key);
+    uint64_t len = rec_len(keylen, n);
+    uint64_t sum = checksum(data, n);   // 락 밖에서
+
+    // 1) 자리 잡기
+    disk_lock();
+    DiskHdr *d = g_hdr;
+    if (len > d->log_size / 4) {   // 한 객체가 로그를 휩쓸지 않게
+        disk_unlock();
+        return;
+    }
+    // 덮을 자리에 아직 복사 중인 레코드가 있으면 이번 것은 디스크에 안 넣음
+    if (d->head + len > d->log_size) {
+        if (evict_until(d->log_size) < 0) goto out;
+        // 끝은 비웠으니 END 표시 후 처음으로. END 가 덮는 끝 구간만 먼저 알림
+        log_reserve((d->lap + 1) * d->log_size);
+        if (d->head + sizeof(DiskRec) <= d->log_size) rec_at(d->head)->magic = REC_END;
+        d->head = 0;
+        d->evict = 0;
+        d->lap++;
+    }
+    if (evict_until(d->head + len) < 0) goto out;
+    uint64_t off = d->head, pos = d->lap * d->log_size + off;
+    log_reserve(pos + len);
+
+    DiskRec *r = rec_at(d->head);
+    r->magic = REC_BUSY;
+    r->keylen = (uint32_t)keylen;
+    r->datalen = n;
+    r->hash = hash;
+    r->sum = sum;
+    r->pos = pos;
+    r->expires = (int64_t)time(NULL);   // 쓰는 동안은 자리 잡은 시각 (BUSY_TIMEOUT 판단용)
+
+    // 앞에 지울 옛 레코드가 없으면 (첫 바퀴) 끝을 END 로 막아 둠 -> 다음 바퀴의 evict 가 여기서 멈춤
+    d->head += len;
+    if (d->evict == d->log_size && d->head + sizeof(DiskRec) <= d->log_size)
+        rec_at(d->head)->magic = REC_END;
+    disk_unlock();
+
+    // 2) 복사는 락 밖에서
+    memcpy((char *)(r + 1), key, keylen);
+    memcpy((char *)(r + 1) + keylen, data, n);
+
+    // 3) 그 사이 덮이지 않았으면 다 쓴 레코드로 바꾸고 인덱스에 올림
+    disk_lock();
+    if (rec_clobbered(pos) || r->magic != REC_BUSY || r->pos != pos) goto out;
+    long old = slot_find(key, hash);
+    if (old >= 0) {
+        if (rec_at(g_slots[old].off)->pos > pos) goto out;   // 더 늦게 잡은 쓰기가 먼저 올라감
+        slot_forget((uint64_t)old);
+    }
+    r->expires = (int64_t)expires;
+    r->magic = REC_MAGIC;
+
+    uint64_t sh = slot_hash(hash);
+    for (uint64_t i = sh & g_mask, k = 0; k < MAX_PROBE; i = (i + 1) & g_mask, k++) {
+        if (!g_slots[i].hash) {
+            g_slots[i].off = off;
+            g_slots[i].hash = sh;
+            // prefix 삭제에서 빠지면 안 되니 목록에 못 올리면 인덱스에서도 뺌
+            if (keys_insert(key, keylen, hash) < 0) slot_delete(i);
+            break;
+        }
+    }
+out:
+    disk_unlock();
+}
+
+void disk_refresh(const char *key, uint64_t hash, time_t expires) {
+    if (!g_hdr) return;
+    disk_lock();
+    long i = slot_find(key, hash);
+    if (i >= 0) rec_at(g_slots[i].off)->expires = (int64_t)expires;
+    disk_unlock();
+}
+
+int disk_remove(const char *key, uint64_t hash) {
+    if (!g_hdr) return 0;
+    disk_lock();
+    long i = slot_find(key, hash);
+    if (i >= 0) slot_forget((uint64_t)i);
+    disk_unlock();
+    return i >= 0;
+}
+
+// radix_prefix 콜백 안에서는 목록을 못 바꾸므로 key 와 해시를 모아 두었다가 지움
+typedef struct {
+    char **keys;
+    uint64_t *hashes;
+    size_t n, cap;
+} KeyList;
+
+static void collect_key(void *arg, const char *key, size_t keylen, void *val) {
+    KeyList *kl = arg;
+    if (kl->n == kl->cap) {
+        size_t cap = kl->cap ? kl->cap * 2 : 64;
+        char **k = realloc(kl->keys, cap * sizeof(*k));
+        if (k) kl->keys = k;
+        uint64_t *h = realloc(kl->hashes, cap * sizeof(*h));
+        if (h) kl->hashes = h;
+        if (!k || !h) return;
+        kl->cap = cap;
+    }
+    if (!(kl->keys[kl->n] = malloc(keylen + 1))) return;
+    memcpy(kl->keys[kl->n], key, keylen + 1);
+    kl->hashes[kl->n++] = (uint64_t)(uintptr_t)val;
+}
+
+// 공유 모드: key 목록이 없으니 인덱스를 훑으며 레코드의 key 를 직접 봄.
+// 다른 프로세스를 오래 세우지 않게 SCAN_BATCH 슬롯마다 락을 놓음. 그 사이 다른 삭제로
+// 항목이 앞으로 당겨졌을 수 있어서 이어 볼 때는 조금 물러나서 봄. 항목은 제자리에서
+// MAX_PROBE 안에만 있으므로 빈 슬롯이나 MAX_PROBE 만큼만 물러나면 충분
+static size_t remove_prefix_scan(const char *prefix, size_t plen) {
+    size_t removed = 0;
+    uint64_t nslots = g_hdr->nslots;
+    for (uint64_t i = 0; i < nslots; ) {
+        uint64_t end = nslots - i > SCAN_BATCH ? i + SCAN_BATCH : nslots;
+        disk_lock();
+        for (int k = 0; k < MAX_PROBE && i > 0 && g_slots[i - 1].hash; k++) i--;
+        while (i < end) {
+            DiskRec *r = rec_at(g_slots[i].off);
+            if (g_slots[i].hash && r->keylen >= plen && !memcmp((char *)(r + 1), prefix, plen)) {
+                slot_delete(i);   // 뒤의 항목이 당겨져 올 수 있으니 i 는 그대로
+                removed++;
+                continue;
+            }
+            i++;
+        }
+        disk_unlock();
+    }
+    return removed;
+}
+
+size_t disk_remove_prefix(const char *prefix) {
+    if (!g_hdr) return 0;
+    KeyList kl = {0};
+    size_t removed = 0;
+
+    if (g_shared) return remove_prefix_scan(prefix, strlen(prefix));
+
+    disk_lock();
+    radix_prefix(&g_keys, prefix, strlen(prefix), collect_key, &kl);
+    for (size_t k = 0; k < kl.n; k++) {
+        long i = slot_find(kl.keys[k], kl.hashes[k]);
+        if (i >= 0) {
+            slot_forget((uint64_t)i);
+            removed++;
+        }
+        free(kl.keys[k]);
+    }
+    disk_unlock();
+    free(kl.keys);
+    free(kl.hashes);
+    return removed;
+}
@@ -0,0 +1,54 @@
+/*
+ * disk.h - mmap 파일 위의 2단 캐시 (재시작해도 남음)
+ *
+ * 파일 = 헤더 + 해시 인덱스 (open addressing) + 원형 로그.
+ * 객체는 로그 끝에 이어 쓰고, 로그가 한 바퀴 돌면 가장 오래된 것부터 덮어씀 (FIFO).
+ * 인덱스도 파일 안에 있으므로 재시작 때는 mmap 하고 헤더만 확인하면 바로 사용 가능.
+ * 메모리 캐시가 넣는 객체를 그대로 따라 써서 (write-through) RAM 예산보다 큰 2단 캐시가 됨
+ *
+ * 같은 배치를 POSIX 공유 메모리에 둘 수도 있음 (disk_open_shared). 위치는 모두 오프셋이고
+ * 락도 헤더 안의 프로세스 공유 mutex 라서, 여러 프록시 프로세스가 한 세그먼트를 같이 씀
+ * -> 프로세스마다 따로 데우지 않고 적중률과 예산을 공유
+ */
+#ifndef __DISK_H__
+#define __DISK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define DISK_DEFAULT_SIZE (64UL * 1024 * 1024)
+
+/* path 파일을 size 바이트로 열고 mmap (없으면 만듦, 크기가 다르면 비우고 다시 씀). 실패 -1 */
+int disk_open(const char *path, size_t size);
+int disk_enabled(void);
+
+/* POSIX 공유 메모리 세그먼트 name ("/proxy-cache" 꼴) 을 size 바이트로 열거나 붙음.
+   이미 있고 크기가 같으면 다른 프로세스가 쓰던 내용을 그대로 씀. 실패 -1 */
+int disk_open_shared(const char *name, size_t size);
+int disk_shared(void);
+
+/* 무효화 세대 (공유 모드). 어느 프로세스든 PURGE 를 하면 disk_invalidate 로 올림.
+   각 프로세스는 세대가 바뀐 걸 보면 자기 메모리 계층을 비움. disk_invalidate 는 올린 뒤 값 */
+uint64_t disk_generation(void);
+uint64_t disk_invalidate(void);
+
+/* key 를 찾으면 alloc(arg, 길이) 가 준 버퍼에 본문을 복사해서 그 버퍼를 돌려줌.
+   없거나 레코드가 깨졌거나 복사하는 사이 덮였거나 alloc 이 NULL 을 주면 NULL.
+   복사는 락 밖에서 하므로 alloc 은 락 없이 불리고, NULL 일 때 받아 간 버퍼는 호출자가 해제 */
+void *disk_get(const char *key, uint64_t hash, time_t *expires,
+               void *(*alloc)(void *arg, size_t n), void *arg);
+
+/* 덮어쓰기 (같은 key 는 새 레코드로 교체) */
+void disk_put(const char *key, uint64_t hash, const char *data, size_t n, time_t expires);
+
+/* 재검증된 레코드의 만료 시각만 갱신 */
+void disk_refresh(const char *key, uint64_t hash, time_t expires);
+
+/* 무효화 (PURGE). 레코드는 로그에 남지만 인덱스에서 빠져서 다시 읽히지 않음.
+   prefix 는 메모리에 둔 key radix tree 로 일치하는 것만 찾음 (공유 모드는 프로세스마다
+   목록을 맞출 수 없어서 인덱스 전체를 훑되, 락은 일정 슬롯마다 놓음). 지운 수 */
+int disk_remove(const char *key, uint64_t hash);
+size_t disk_remove_prefix(const char *prefix);
+
+#endif /* __DISK_H__ */
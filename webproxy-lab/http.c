@@ -0,0 +1,245 @@
+/*
+ * http.c - 응답 헤더 파싱과 신선도 계산 (http.h 참고)
+ */
+#include "http.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define HEURISTIC_MAX (24 * 3600)   // Last-Modified 휴리스틱 상한 (하루)
+
+size_t http_header_end(const char *buf, size_t len) {
+    for (size_t i = 1; i < len; i++)
+        if (buf[i] == '\n' && (buf[i - 1] == '\n' || (i >= 2 && buf[i - 1] == '\r' && buf[i - 2] == '\n')))
+            return i + 1;
+    return 0;
+}
+
+// 이름이 같으면 값 시작 (앞 공백 건너뜀), 아니면 NULL
+static const char *header_value(const char *line, const char *end, const char *name) {
+    size_t n = strlen(name);
+    if ((size_t)(end - line) <= n || line[n] != ':' || strncasecmp(line, name, n)) return NULL;
+    const char *v = line + n + 1;
+    while (v < end && (*v == ' ' || *v == '\t')) v++;
+    return v;
+}
+
+// 숫자 값 (음수/형식 오류면 -1)
+static long parse_seconds(const char *s, const char *end) {
+    if (s >= end || !isdigit((unsigned char)*s)) return -1;
+    long v = 0;
+    while (s < end && isdigit((unsigned char)*s)) {
+        if (v > 100000000L) return v;   // 충분히 큼 (넘침 방지)
+        v = v * 10 + (*s++ - '0');
+    }
+    return v;
+}
+
+// 바이트 수 (형식 오류거나 너무 크면 -1)
+static long long parse_length(const char *s, const char *end) {
+    if (s >= end || !isdigit((unsigned char)*s)) return -1;
+    long long v = 0;
+    while (s < end && isdigit((unsigned char)*s)) {
+        if (v > (LLONG_MAX - 9) / 10) return -1;
+        v = v * 10 + (*s++ - '0');
+    }
+    while (s < end && (*s == ' ' || *s == '\t')) s++;
+    return s == end ? v : -1;
+}
+
+// "max-age=60, no-cache, private" 같은 목록
+static void parse_cache_control(const char *v, const char *end, HttpMeta *m) {
+    while (v < end) {
+        while (v < end && (*v == ' ' || *v == '\t' || *v == ',')) v++;
+        const char *tok = v;
+        while (v < end && *v != ',') v++;
+        size_t n = (size_t)(v - tok);
+        while (n && (tok[n - 1] == ' ' || tok[n - 1] == '\t')) n--;
+
+        if (n == 8 && !strncasecmp(tok, "no-store", 8)) m->no_store = 1;
+        // no-cache="field" 처럼 필드를 지정한 형태도 보수적으로 전체 no-cache 로 봄
+        else if (n >= 8 && !strncasecmp(tok, "no-cache", 8)) m->no_cache = 1;
+        else if (n >= 7 && !strncasecmp(tok, "private", 7)) m->is_private = 1;
+        else if (n > 8 && !strncasecmp(tok, "max-age=", 8)) m->max_age = parse_seconds(tok + 8, tok + n);
+        else if (n > 9 && !strncasecmp(tok, "s-maxage=", 9)) m->s_maxage = parse_seconds(tok + 9, tok + n);
+        else if ((n == 15 && !strncasecmp(tok, "must-revalidate", 15)) ||
+                 (n == 16 && !strncasecmp(tok, "proxy-revalidate", 16))) m->must_revalidate = 1;
+        else if (n > 23 && !strncasecmp(tok, "stale-while-revalidate=", 23)) m->swr = parse_seconds(tok + 23, tok + n);
+        else if (n > 15 && !strncasecmp(tok, "stale-if-error=", 15)) m->sie = parse_seconds(tok + 15, tok + n);
+    }
+}
+
+int http_parse_response(const char *hdr, size_t len, HttpMeta *m) {
+    const char *end = hdr + len;
+    memset(m, 0, sizeof(*m));
+    m->max_age = m->s_maxage = m->swr = m->sie = -1;
+    m->content_length = -1;
+
+    // 상태 줄 "HTTP/1.x 200 OK"
+    const char *eol = memchr(hdr, '\n', len);
+    if (!eol || len < 12 || strncmp(hdr, "HTTP/", 5)) return -1;
+    const char *sp = memchr(hdr, ' ', (size_t)(eol - hdr));
+    if (!sp || (m->status = (int)parse_seconds(sp + 1, eol)) < 100) return -1;
+
+    for (const char *line = eol + 1; line < end; ) {
+        const char *next = memchr(line, '\n', (size_t)(end - line));
+        if (!next) next = end;
+        const char *lend = next;
+        if (lend > line && lend[-1] == '\r') lend--;
+        const char *v;
+
+        if ((v = header_value(line, lend, "Cache-Control"))) {
+            parse_cache_control(v, lend, m);
+        } else if ((v = header_value(line, lend, "Pragma"))) {
+            if (lend - v >= 8 && !strncasecmp(v, "no-cache", 8)) m->no_cache = 1;
+        } else if ((v = header_value(line, lend, "Expires"))) {
+            m->expires = http_parse_date(v, (size_t)(lend - v));
+            if (!m->expires) m->expires = 1;   // "0" 같은 잘못된 값은 이미 만료로
+        } else if ((v = header_value(line, lend, "Date"))) {
+            m->date = http_parse_date(v, (size_t)(lend - v));
+        } else if ((v = header_value(line, lend, "Age"))) {
+            long age = parse_seconds(v, lend);
+            if (age > 0) m->age = age;
+        } else if ((v = header_value(line, lend, "Content-Length"))) {
+            m->content_length = parse_length(v, lend);
+        } else if ((v = header_value(line, lend, "Last-Modified"))) {
+            m->last_modified = http_parse_date(v, (size_t)(lend - v));
+            m->lastmod = v;
+            m->lastmod_len = (size_t)(lend - v);
+        } else if ((v = header_value(line, lend, "ETag"))) {
+            m->etag = v;
+            m->etag_len = (size_t)(lend - v);
+        } else if ((v = header_value(line, lend, "Surrogate-Key"))) {
+            m->skeys = v;
+            m->skeys_len = (size_t)(lend - v);
+        }
+        line = next + 1;
+    }
+    return 0;
+}
+
+int http_negative(const HttpMeta *m) {
+    return m->status == 404 || m->status == 410;
+}
+
+int http_storable(const HttpMeta *m) {
+    return (m->status == 200 || http_negative(m)) && !m->no_store && !m->is_private;
+}
+
+time_t http_negative_expires_at(const HttpMeta *m, time_t now, long ttl) {
+    // 서버가 수명을 정했으면 따르고, 휴리스틱 대신 짧은 ttl
+    if (m->no_cache || m->s_maxage >= 0 || m->max_age >= 0 || m->expires) return http_expires_at(m, now);
+    return now + ttl;
+}
+
+time_t http_expires_at(const HttpMeta *m, time_t now) {
+    if (m->no_cache) return now;
+
+    long lifetime;
+    if (m->s_maxage >= 0) lifetime = m->s_maxage;
+    else if (m->max_age >= 0) lifetime = m->max_age;
+    else if (m->expires) lifetime = (long)(m->expires - (m->date ? m->date : now));
+    else if (m->last_modified && m->date > m->last_modified) {
+        // 명시된 수명이 없으면 마지막 수정 이후 경과 시간의 10%
+        lifetime = (long)(m->date - m->last_modified) / 10;
+        if (lifetime > HEURISTIC_MAX) lifetime = HEURISTIC_MAX;
+    } else lifetime = HTTP_DEFAULT_TTL;
+
+    // 오는 길에 다른 캐시에서 이미 보낸 시간만큼 뺌
+    lifetime -= m->age;
+    return lifetime > 0 ? now + lifetime : now;
+}
+
+time_t http_stale_until(const HttpMeta *m, time_t expires, long grace, int on_error) {
+    if (m->no_cache || m->must_revalidate) return expires;
+    long window = on_error ? m->sie : m->swr;
+    if (window < 0) window = grace;
+    return expires + window;
+}
+
+// 바이트 위치 숫자. 숫자가 없거나 넘치면 -1
+static int parse_offset(const char **p, const char *end, size_t *out) {
+    const char *s = *p;
+    size_t v = 0;
+    if (s >= end || !isdigit((unsigned char)*s)) return -1;
+    while (s < end && isdigit((unsigned char)*s)) {
+        if (v > ((size_t)-1 - 9) / 10) return -1;
+        v = v * 10 + (size_t)(*s++ - '0');
+    }
+    *p = s;
+    *out = v;
+    return 0;
+}
+
+int http_parse_range(const char *v, size_t len, size_t total, HttpRange *out, int max) {
+    const char *end = v + len;
+    int n = 0, specs = 0;
+
+    while (v < end && (*v == ' ' || *v == '\t')) v++;
+    if (end - v < 6 || strncasecmp(v, "bytes=", 6)) return -1;
+    v += 6;
+
+    while (v < end) {
+        while (v < end && (*v == ' ' || *v == '\t' || *v == ',')) v++;
+        if (v == end) break;
+        if (++specs > max) return -1;
+
+        size_t first, last;
+        if (*v == '-') {
+            // 끝에서 last 바이트 (suffix)
+            v++;
+            if (parse_offset(&v, end, &last) < 0) return -1;
+            if (last == 0 || total == 0) goto next;
+            first = last < total ? total - last : 0;
+            last = total - 1;
+        } else {
+            if (parse_offset(&v, end, &first) < 0 || v == end || *v++ != '-') return -1;
+            if (v < end && isdigit((unsigned char)*v)) {
+                if (parse_offset(&v, end, &last) < 0 || last < first) return -1;
+            } else {
+                last = (size_t)-1;   // "a-": 끝까지
+            }
+            if (first >= total) goto next;   // 본문 밖 (다른 구간이 맞으면 그것만)
+            if (last >= total) last = total - 1;
+        }
+        out[n].first = first;
+        out[n].last = last;
+        n++;
+next:
+        while (v < end && (*v == ' ' || *v == '\t')) v++;
+        if (v < end && *v != ',') return -1;
+    }
+    return specs ? n : -1;
+}
+
+// 1970-01-01 부터 날짜까지 일 수 (그레고리력)
+static long days_from_civil(int y, int mon, int d) {
+    y -= mon <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+time_t http_parse_date(const char *s, size_t len) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char buf[64], mon[4];
+    int d, y, hh, mm, ss;
+
+    if (len >= sizeof(buf)) return 0;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+
+    // IMF-fixdate 만 지원 (obsolete 형식은 날짜 없음으로 취급)
+    if (sscanf(buf, "%*3s, %d %3s %d %d:%d:%d", &d, mon, &y, &hh, &mm, &ss) != 6) return 0;
+    const char *p = strstr(months, mon);
+    if (!p || (p - months) % 3) return 0;
+    int m = (int)(p - months) / 3 + 1;
+
+    return (time_t)(days_from_civil(y, m, d) * 86400L + hh * 3600L + mm * 60L + ss);
+}
@@ -0,0 +1,71 @@
+/*
+ * http.h - 응답 헤더에서 캐시 판단에 필요한 것만 뽑음 (RFC 9111 일부)
+ *
+ * 상태 코드, Cache-Control (max-age / s-maxage / no-store / no-cache / private /
+ * must-revalidate / stale-while-revalidate / stale-if-error (RFC 5861)),
+ * Expires, Date, Age, Content-Length, 그리고 재검증용 ETag / Last-Modified
+ */
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#include <stddef.h>
+#include <time.h>
+
+#define HTTP_DEFAULT_TTL 300   /* 신선도 정보가 전혀 없는 응답의 기본 수명 (초) */
+
+typedef struct {
+    int status;
+    int no_store, no_cache, is_private;
+    long max_age, s_maxage;        /* 없으면 -1 */
+    long swr, sie;                 /* stale-while-revalidate / stale-if-error 초, 없으면 -1 */
+    int must_revalidate;           /* must-revalidate / proxy-revalidate: 만료 뒤엔 절대 그대로 못 씀 */
+    long age;                      /* Age 헤더, 없으면 0 */
+    long long content_length;      /* Content-Length, 없거나 잘못됐으면 -1 */
+    time_t date;                   /* 없으면 0 */
+    time_t expires;                /* 없으면 0, 잘못된 값이면 1 (이미 만료) */
+    time_t last_modified;          /* 없으면 0 */
+
+    /* 재검증 때 그대로 돌려보낼 값. hdr 안을 가리킴 (NUL 종료 아님) */
+    const char *etag;      size_t etag_len;
+    const char *lastmod;   size_t lastmod_len;
+    const char *skeys;     size_t skeys_len;   /* Surrogate-Key: 공백으로 나눈 태그 목록 */
+} HttpMeta;
+
+/* 빈 줄까지의 응답 헤더 블록 끝 위치 (빈 줄 포함 길이). 아직 덜 왔으면 0.
+   줄 끝은 CRLF 가 원칙이지만 LF 만 쓰는 서버도 받아 줌 (빈 줄이 "\r\n" 또는 "\n") */
+size_t http_header_end(const char *buf, size_t len);
+
+/* hdr 은 상태 줄부터 빈 줄까지. 상태 줄이 이상하면 -1 */
+int http_parse_response(const char *hdr, size_t len, HttpMeta *m);
+
+/* 공유 캐시에 저장해도 되는 응답인가 (200 또는 404/410, no-store/private 아님) */
+int http_storable(const HttpMeta *m);
+
+/* 없는 자원이라는 응답 (404/410). 짧게만 저장 (negative caching) */
+int http_negative(const HttpMeta *m);
+
+/* negative 응답의 만료 시각: 명시된 수명이 있으면 http_expires_at, 없으면 now + ttl */
+time_t http_negative_expires_at(const HttpMeta *m, time_t now, long ttl);
+
+/* 신선도 수명이 끝나는 절대 시각. s-maxage > max-age > Expires > Last-Modified 휴리스틱 > 기본값.
+   no-cache 면 now (매번 재검증) */
+time_t http_expires_at(const HttpMeta *m, time_t now);
+
+/* 만료 (expires) 뒤에도 저장된 응답을 그대로 보내도 되는 마지막 시각.
+   on_error 면 업스트림 실패 때 (stale-if-error), 아니면 백그라운드 재검증 동안 (stale-while-revalidate).
+   헤더에 창이 없으면 운영자가 정한 grace 초. no-cache / must-revalidate 면 expires (허용 안 함) */
+time_t http_stale_until(const HttpMeta *m, time_t expires, long grace, int on_error);
+
+/* 요청 Range 의 한 구간 (양 끝 포함, 본문 기준 바이트 위치) */
+typedef struct {
+    size_t first, last;
+} HttpRange;
+
+/* "bytes=0-99, 200-, -50" 을 길이 total 인 본문에 맞춰 out 에 풂 (최대 max 개).
+   맞는 구간 수, 하나도 본문 안에 없으면 0 (416), 형식이 틀렸거나 max 개보다 많으면 -1 (Range 무시) */
+int http_parse_range(const char *v, size_t len, size_t total, HttpRange *out, int max);
+
+/* "Sun, 06 Nov 1994 08:49:37 GMT" -> time_t. 실패 0 */
+time_t http_parse_date(const char *s, size_t len);
+
+#endif /* __HTTP_H__ */
@@ -0,0 +1,415 @@
+/*
+ * policy.c - 교체 정책 구현들 (policy.h 참고)
+ */
+#include "policy.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 공통: 삽입 순서 이중 연결 리스트 */
+typedef struct {
+    PolNode *head;   // 최근 삽입
+    PolNode *tail;   // 가장 오래전 삽입
+} PolList;
+
+static void list_push(PolList *l, PolNode *n) {
+    n->prev = NULL;
+    n->next = l->head;
+    if (l->head) l->head->prev = n;
+    l->head = n;
+    if (!l->tail) l->tail = n;
+}
+
+static void list_unlink(PolList *l, PolNode *n) {
+    if (n->prev) n->prev->next = n->next;
+    else l->head = n->next;
+    if (n->next) n->next->prev = n->prev;
+    else l->tail = n->prev;
+    n->prev = n->next = NULL;
+}
+
+/* CLOCK (second chance)
+  바늘 위치의 ref 가 1이면 0으로 내리고 다음으로, 0이면 그 엔트리를 내보냄.
+  한 바퀴 안에 반드시 ref 0 이 생기므로 전체 스캔 없이 분할상환 O(1) */
+typedef struct {
+    PolList l;
+    PolNode *hand;   // tail -> head 로 진행, NULL 이면 tail 부터
+} Clock;
+
+static void *clock_create(size_t budget) {
+    (void)budget;
+    return calloc(1, sizeof(Clock));
+}
+
+// 교체된 key 는 참조 비트를 이어받음
+static int clock_insert(void *st, PolNode *n, const PolNode *old) {
+    unsigned char ref = old ? atomic_load_explicit(&old->ref, memory_order_relaxed) : 0;
+    atomic_store_explicit(&n->ref, ref, memory_order_relaxed);
+    list_push(&((Clock *)st)->l, n);
+    return 0;
+}
+
+// 참조 비트만 켬 (리스트 이동 없음, 이미 켜져 있으면 쓰지 않음)
+static void clock_hit(void *st, PolNode *n) {
+    (void)st;
+    if (!atomic_load_explicit(&n->ref, memory_order_relaxed))
+        atomic_store_explicit(&n->ref, 1, memory_order_relaxed);
+}
+
+static PolNode *clock_victim(void *st) {
+    Clock *c = st;
+    if (!c->l.tail) return NULL;
+    while (1) {
+        PolNode *n = c->hand ? c->hand : c->l.tail;
+        c->hand = n->prev;
+        if (!atomic_exchange_explicit(&n->ref, 0, memory_order_relaxed))
+            return n;
+    }
+}
+
+// clock_victim 을 흉내만 냄: 바늘부터 한 바퀴 돌며 참조 비트 꺼진 첫 노드, 다 켜져 있으면 바늘 자리
+static PolNode *clock_peek(void *st) {
+    Clock *c = st;
+    if (!c->l.tail) return NULL;
+    PolNode *start = c->hand ? c->hand : c->l.tail, *n = start;
+    do {
+        if (!atomic_load_explicit(&n->ref, memory_order_relaxed)) return n;
+        n = n->prev ? n->prev : c->l.tail;
+    } while (n != start);
+    return start;
+}
+
+static void clock_remove(void *st, PolNode *n, int evicted) {
+    Clock *c = st;
+    (void)evicted;
+    if (c->hand == n) c->hand = n->prev;   // 바늘은 다음 후보로
+    list_unlink(&c->l, n);
+}
+
+/* GDSF
+  우선순위 H = L + hits / size. 가장 낮은 것을 내보내고 L 을 그 H 로 올림 (inflation)
+  -> 오래 안 쓰인 객체는 새로 들어오는 객체보다 점점 낮아짐.
+  히트는 읽기 락 아래라 hits 만 올리고, 힙 위치는 victim 때 게으르게 고침:
+  꼭대기의 hits 가 계산 때와 다르면 다시 계산해서 내려보내고 다음 꼭대기를 봄.
+  hits 는 늘기만 하므로 힙 안의 값은 실제보다 작거나 같음 -> 진짜 최소를 놓치지 않음 */
+typedef struct {
+    PolNode **heap;
+    size_t n, cap;
+    double L;
+} Gdsf;
+
+static double gdsf_prio(Gdsf *g, PolNode *n, unsigned hits) {
+    return g->L + (double)hits / (double)n->size;
+}
+
+static void heap_set(Gdsf *g, size_t i, PolNode *n) {
+    g->heap[i] = n;
+    n->heap_idx = i;
+}
+
+static void sift_up(Gdsf *g, size_t i) {
+    PolNode *n = g->heap[i];
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (g->heap[p]->prio <= n->prio) break;
+        heap_set(g, i, g->heap[p]);
+        i = p;
+    }
+    heap_set(g, i, n);
+}
+
+static void sift_down(Gdsf *g, size_t i) {
+    PolNode *n = g->heap[i];
+    while (1) {
+        size_t c = 2 * i + 1;
+        if (c >= g->n) break;
+        if (c + 1 < g->n && g->heap[c + 1]->prio < g->heap[c]->prio) c++;
+        if (g->heap[c]->prio >= n->prio) break;
+        heap_set(g, i, g->heap[c]);
+        i = c;
+    }
+    heap_set(g, i, n);
+}
+
+static void *gdsf_create(size_t budget) {
+    (void)budget;
+    return calloc(1, sizeof(Gdsf));
+}
+
+// 교체된 key 는 히트 수를 이어받음 (우선순위는 새 크기로)
+static int gdsf_insert(void *st, PolNode *n, const PolNode *old) {
+    Gdsf *g = st;
+    unsigned hits = old ? atomic_load_explicit(&old->hits, memory_order_relaxed) : 1;
+    if (g->n == g->cap) {
+        size_t cap = g->cap ? g->cap * 2 : 64;
+        PolNode **h = realloc(g->heap, cap * sizeof(*h));
+        if (!h) return -1;
+        g->heap = h;
+        g->cap = cap;
+    }
+    atomic_store_explicit(&n->hits, hits, memory_order_relaxed);
+    n->prio_hits = hits;
+    n->prio = gdsf_prio(g, n, hits);
+    heap_set(g, g->n++, n);
+    sift_up(g, n->heap_idx);
+    return 0;
+}
+
+static void gdsf_hit(void *st, PolNode *n) {
+    (void)st;
+    atomic_fetch_add_explicit(&n->hits, 1, memory_order_relaxed);
+}
+
+static PolNode *gdsf_victim(void *st) {
+    Gdsf *g = st;
+    while (g->n) {
+        PolNode *top = g->heap[0];
+        unsigned hits = atomic_load_explicit(&top->hits, memory_order_relaxed);
+        if (hits == top->prio_hits) return top;
+        top->prio_hits = hits;
+        top->prio = gdsf_prio(g, top, hits);
+        sift_down(g, 0);
+    }
+    return NULL;
+}
+
+static void gdsf_remove(void *st, PolNode *n, int evicted) {
+    Gdsf *g = st;
+    if (evicted && n->prio > g->L) g->L = n->prio;
+    size_t i = n->heap_idx;
+    PolNode *last = g->heap[--g->n];
+    if (i == g->n) return;
+    heap_set(g, i, last);
+    if (i > 0 && g->heap[(i - 1) / 2]->prio > last->prio) sift_up(g, i);
+    else sift_down(g, i);
+}
+
+/* CAR (Clock with Adaptive Replacement, ARC 의 CLOCK 판)
+  T1: 캐시에 들어온 뒤 아직 다시 안 쓰인 것, T2: 두 번 이상 쓰인 것. 둘 다 head 가 최근.
+  히트는 ref 비트만 켜고, victim 때 T1 의 가장 오래된 것이 ref 면 T2 로 옮김 (리스트 이동은 모두 O(1)).
+  내보낸 key 는 해시와 크기만 유령 목록 B1 (T1 에서 나감) / B2 (T2 에서 나감) 에 남김.
+  B1 유령이 다시 오면 최근성이 부족했던 것 -> T1 목표 p 를 늘리고, B2 유령이면 줄임.
+  객체 크기가 제각각이라 목록 크기와 p 는 모두 바이트 단위 */
+enum { CAR_T1 = 1, CAR_T2 };
+
+typedef struct Ghost {
+    uint64_t hash;
+    size_t size;
+    int b2;                          // B2 에 있으면 1
+    struct Ghost *prev, *next;       // B1/B2 목록 (head 가 최근)
+    struct Ghost *hnext;             // 해시 체인
+} Ghost;
+
+typedef struct {
+    Ghost *head, *tail;
+    size_t bytes;
+} GhostList;
+
+typedef struct {
+    PolList t1, t2;
+    size_t t1_bytes, t2_bytes;
+    GhostList b1, b2;
+    Ghost **gtab;                    // 유령 해시 인덱스 (2의 거듭제곱)
+    size_t gtab_n, ghosts;
+    size_t c;                        // 샤드 예산
+    size_t p;                        // T1 목표 바이트
+} Car;
+
+static void *car_create(size_t budget) {
+    Car *c = calloc(1, sizeof(Car));
+    if (!c) return NULL;
+    c->gtab_n = 64;
+    c->gtab = calloc(c->gtab_n, sizeof(Ghost *));
+    if (!c->gtab) {
+        free(c);
+        return NULL;
+    }
+    c->c = budget;
+    return c;
+}
+
+static Ghost **ghost_slot(Car *c, uint64_t h) {
+    Ghost **pp = &c->gtab[h & (c->gtab_n - 1)];
+    while (*pp && (*pp)->hash != h) pp = &(*pp)->hnext;
+    return pp;
+}
+
+// 유령 목록과 인덱스에서 빼고 해제
+static void ghost_drop(Car *c, Ghost *g) {
+    GhostList *l = g->b2 ? &c->b2 : &c->b1;
+    if (g->prev) g->prev->next = g->next;
+    else l->head = g->next;
+    if (g->next) g->next->prev = g->prev;
+    else l->tail = g->prev;
+    l->bytes -= g->size;
+
+    Ghost **pp = ghost_slot(c, g->hash);
+    while (*pp != g) pp = &(*pp)->hnext;
+    *pp = g->hnext;
+    c->ghosts--;
+    free(g);
+}
+
+// 인덱스가 차면 두 배로 (실패하면 체인이 길어질 뿐)
+static void ghost_grow(Car *c) {
+    size_t n = c->gtab_n * 2;
+    Ghost **tab = calloc(n, sizeof(Ghost *));
+    if (!tab) return;
+    for (size_t i = 0; i < c->gtab_n; i++) {
+        for (Ghost *g = c->gtab[i], *next; g; g = next) {
+            next = g->hnext;
+            g->hnext = tab[g->hash & (n - 1)];
+            tab[g->hash & (n - 1)] = g;
+        }
+    }
+    free(c->gtab);
+    c->gtab = tab;
+    c->gtab_n = n;
+}
+
+static void ghost_add(Car *c, uint64_t h, size_t size, int b2) {
+    Ghost **pp = ghost_slot(c, h);
+    if (*pp) ghost_drop(c, *pp);   // 같은 해시 유령은 새 것으로
+    Ghost *g = malloc(sizeof(*g));
+    if (!g) return;                // 유령은 없어도 정확성에는 문제 없음
+    if (c->ghosts + 1 > c->gtab_n) ghost_grow(c);
+
+    g->hash = h;
+    g->size = size;
+    g->b2 = b2;
+    GhostList *l = b2 ? &c->b2 : &c->b1;
+    g->prev = NULL;
+    g->next = l->head;
+    if (l->head) l->head->prev = g;
+    l->head = g;
+    if (!l->tail) l->tail = g;
+    l->bytes += size;
+
+    pp = &c->gtab[h & (c->gtab_n - 1)];
+    g->hnext = *pp;
+    *pp = g;
+    c->ghosts++;
+}
+
+// 유령 목록이 예산을 넘지 않게: |T1|+|B1| <= c, 전체 <= 2c
+static void ghost_trim(Car *c) {
+    while (c->b1.tail && c->t1_bytes + c->b1.bytes > c->c) ghost_drop(c, c->b1.tail);
+    while (c->b2.tail && c->t1_bytes + c->t2_bytes + c->b1.bytes + c->b2.bytes > 2 * c->c)
+        ghost_drop(c, c->b2.tail);
+}
+
+static void car_push(Car *c, PolNode *n, int seg) {
+    n->seg = seg;
+    if (seg == CAR_T1) {
+        list_push(&c->t1, n);
+        c->t1_bytes += n->size;
+    } else {
+        list_push(&c->t2, n);
+        c->t2_bytes += n->size;
+    }
+}
+
+static void car_unlink(Car *c, PolNode *n) {
+    if (n->seg == CAR_T1) {
+        list_unlink(&c->t1, n);
+        c->t1_bytes -= n->size;
+    } else {
+        list_unlink(&c->t2, n);
+        c->t2_bytes -= n->size;
+    }
+}
+
+static int car_insert(void *st, PolNode *n, const PolNode *old) {
+    Car *c = st;
+    if (old) {
+        // 캐시에 있던 key 의 교체: 들어 있던 목록 (T2 면 T2) 과 참조 비트를 그대로
+        atomic_store_explicit(&n->ref, atomic_load_explicit(&old->ref, memory_order_relaxed),
+                              memory_order_relaxed);
+        car_push(c, n, old->seg);
+        return 0;
+    }
+    Ghost *g = *ghost_slot(c, n->hash);
+    atomic_store_explicit(&n->ref, 0, memory_order_relaxed);
+
+    if (!g) {
+        car_push(c, n, CAR_T1);
+    } else {
+        // 유령 적중: 그쪽 목록이 작았던 것이므로 p 를 그쪽으로 옮기고 T2 로 바로 넣음
+        size_t b1 = c->b1.bytes ? c->b1.bytes : 1, b2 = c->b2.bytes ? c->b2.bytes : 1;
+        if (!g->b2) {
+            size_t d = n->size * (b2 > b1 ? b2 / b1 : 1);
+            c->p = c->p + d < c->c ? c->p + d : c->c;
+        } else {
+            size_t d = n->size * (b1 > b2 ? b1 / b2 : 1);
+            c->p = c->p > d ? c->p - d : 0;
+        }
+        ghost_drop(c, g);
+        car_push(c, n, CAR_T2);
+    }
+    ghost_trim(c);
+    return 0;
+}
+
+static PolNode *car_victim(void *st) {
+    Car *c = st;
+    while (c->t1.tail || c->t2.tail) {
+        // T1 이 목표보다 크면 T1 에서, 아니면 T2 에서 (빈 쪽은 건너뜀)
+        int from_t1 = c->t1.tail && (c->t1_bytes >= (c->p ? c->p : 1) || !c->t2.tail);
+        PolNode *n = from_t1 ? c->t1.tail : c->t2.tail;
+        if (!atomic_exchange_explicit(&n->ref, 0, memory_order_relaxed)) return n;
+        // 다시 쓰인 것: T1 이면 T2 로 승격, T2 면 T2 의 최근 쪽으로 (second chance)
+        car_unlink(c, n);
+        car_push(c, n, CAR_T2);
+    }
+    return NULL;
+}
+
+// car_victim 을 흉내만 냄. 참조된 노드는 T2 head 로 가므로, 원래 목록이 다 떨어지면
+// 처음 옮겨졌을 노드 (참조 비트가 꺼진 채) 가 T2 의 tail
+static PolNode *car_peek(void *st) {
+    Car *c = st;
+    PolNode *a = c->t1.tail, *b = c->t2.tail, *moved = NULL;
+    size_t t1_bytes = c->t1_bytes;
+    while (a || b || moved) {
+        PolNode *t2 = b ? b : moved;
+        int from_t1 = a && (t1_bytes >= (c->p ? c->p : 1) || !t2);
+        PolNode *n = from_t1 ? a : t2;
+        if (n == moved || !atomic_load_explicit(&n->ref, memory_order_relaxed)) return n;
+        if (!moved) moved = n;
+        if (from_t1) {
+            t1_bytes -= n->size;
+            a = n->prev;
+        } else {
+            b = n->prev;
+        }
+    }
+    return NULL;
+}
+
+static void car_remove(void *st, PolNode *n, int evicted) {
+    Car *c = st;
+    int seg = n->seg;
+    car_unlink(c, n);
+    if (evicted) {
+        ghost_add(c, n->hash, n->size, seg == CAR_T2);
+        ghost_trim(c);
+    }
+}
+
+static const Policy g_policies[] = {
+    { "clock", clock_create, clock_insert, clock_hit, clock_victim, clock_peek,  clock_remove },
+    // GDSF 의 victim 은 밀린 우선순위만 고쳐 힙을 맞추므로 그대로 peek 으로 씀
+    { "gdsf",  gdsf_create,  gdsf_insert,  gdsf_hit,  gdsf_victim, gdsf_victim, gdsf_remove },
+    { "car",   car_create,   car_insert,   clock_hit, car_victim,   car_peek,    car_remove },
+};
+
+const Policy *policy_find(const char *name) {
+    for (size_t i = 0; i < sizeof(g_policies) / sizeof(g_policies[0]); i++)
+        if (!strcmp(g_policies[i].name, name)) return &g_policies[i];
+    return NULL;
+}
+
+const char *policy_names(void) {
+    return "clock|gdsf|car";
+}
@@ -0,0 +1,53 @@
+/*
+ * policy.h - 캐시 교체 정책 인터페이스
+ *
+ * 샤드마다 정책 상태 하나. 캐시는 엔트리에 PolNode 를 박아 두고
+ * 넣을 때 insert, 히트 때 hit, 자리가 모자라면 victim 으로 후보를 받아 remove 함.
+ * 입장 심사처럼 내보낼지 아직 모를 때는 peek 으로 후보만 봄.
+ * hit 는 샤드 읽기 락만 잡힌 채로 불리므로 atomic 필드만 건드리고,
+ * 리스트/힙 정리는 쓰기 락 아래의 victim 에서 몰아서 함
+ *
+ *   clock - CLOCK (second chance). 참조 비트만 보는 LRU 근사 (기본값)
+ *   gdsf  - Greedy-Dual-Size-Frequency. 우선순위 L + 히트수/크기 가 가장 낮은 것부터.
+ *           작은 객체를 오래 두므로 바이트보다 객체 적중률이 높음
+ *   car   - ARC 의 CLOCK 판 (CAR). 한 번 본 것(T1)과 두 번 이상 본 것(T2)을 나눠 두고,
+ *           내보낸 key 의 해시를 유령 목록(B1, B2)에 남겨서 어느 쪽 유령이 다시 오는지에 따라
+ *           T1 목표 크기 p 를 바꿈 -> 최근성/빈도 사이를 스스로 조절, 스캔에 강함
+ */
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct PolNode {
+    struct PolNode *prev, *next;   /* 정책 리스트 */
+    _Atomic unsigned char ref;     /* 히트 표시 (CLOCK 참조 비트) */
+    _Atomic unsigned hits;         /* 넣은 뒤 접근 수 (넣을 때 1) */
+    size_t size;                   /* 예산에서 차지하는 바이트 */
+    uint64_t hash;                 /* key 해시 */
+    double prio;                   /* GDSF 우선순위, prio_hits 기준으로 계산한 값 */
+    unsigned prio_hits;
+    size_t heap_idx;
+    int seg;                       /* CAR: 들어 있는 목록 (T1/T2) */
+} PolNode;
+
+typedef struct {
+    const char *name;
+    void *(*create)(size_t budget);               /* 샤드 하나의 상태 (budget = 샤드 바이트 예산). 실패 NULL */
+    /* size, hash 는 채워서 호출. 같은 key 를 새 버전으로 바꾸는 것이면 old 에 빼기 전 옛 노드의
+       사본 (목록/참조/히트 상태를 이어받음), 아니면 NULL. 실패 -1 */
+    int (*insert)(void *st, PolNode *n, const PolNode *old);
+    void (*hit)(void *st, PolNode *n);            /* 읽기 락만 잡힌 상태 */
+    PolNode *(*victim)(void *st);                 /* 다음에 내보낼 후보 (빼지는 않음), 없으면 NULL */
+    PolNode *(*peek)(void *st);                   /* victim 이 고를 후보를 상태 (바늘/참조 비트) 변경 없이 */
+    void (*remove)(void *st, PolNode *n, int evicted);   /* evicted: 예산 때문에 내보냄 */
+} Policy;
+
+/* 이름으로 찾기, 없으면 NULL */
+const Policy *policy_find(const char *name);
+
+/* 사용법 출력용 "clock|gdsf|car" */
+const char *policy_names(void);
+
+#endif /* __POLICY_H__ */
@@ -1,68 +1,383 @@
 #include "csapp.h"
+#include "uring.h"
+#include "arena.h"
+#include "cache.h"
+#include "http.h"
+#include "disk.h"
+#include "affinity.h"
 #include <ctype.h>
 #include <pthread.h>
 #include <stddef.h>
-#include <stdatomic.h>   // last_use, g_ticks
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
 
-/* Recommended max cache and object sizes */
-#define MAX_CACHE_SIZE 1049000
-#define MAX_OBJECT_SIZE 102400
+/* You won't lose style points for including this long line in your code */
+static const char *user_agent_hdr =
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 "
+    "Firefox/10.0.3\r\n";
 
-typedef struct Entry {
-    char *key;
+#define ARENA_BLOCK (32 * 1024)     // 연결 arena 기본 블록 (rio_t + 줄 버퍼 + 문자열들)
+#define HDRS_MAX (MAXLINE * 8)       // 전달할 클라이언트 헤더 최대 크기
+#define RESP_HDR_MAX (MAXLINE * 8)   // 캐시 판단을 위해 모으는 서버 응답 헤더 최대 크기
+#define DEFAULT_STACK_KB 256         // 연결 스레드 스택 크기 기본값 (-k)
+#define REFRESH_WORKERS 2            // 백그라운드 재검증 스레드 수
+#define REFRESH_QUEUE_MAX 256        // 밀린 재검증이 이보다 많으면 새 것은 버림
+#define REFRESH_AHEAD_HITS 4         // 미리 갱신할 만큼 뜨겁다고 볼 수명당 히트 수 기본값 (-H)
+#define NEG_TTL_DEFAULT 10           // 404/410, 연결 안 되는 origin 을 기억하는 시간 기본값 (-N)
+#define STATS_PATH "/_proxy/stats"   // 프록시 자신에게 온 요청 ("GET /path") 중 캐시 통계
+#define RANGE_MAX 16                 // 이보다 많은 구간을 달라는 Range 는 무시하고 전체 응답
+#define RESOLVE_WORKERS 2            // 이벤트 루프 대신 DNS 조회를 하는 스레드 수
+#define DNS_TTL 30                   // 조회한 origin 주소를 기억하는 시간 (초)
+#define DNS_SLOTS 256                // 주소 캐시 칸 수 (origin 별, 겹치면 덮어씀)
+#define DNS_MAX_ADDRS 4              // origin 하나에 기억하는 주소 수
+
+// 요청 라인에서 뽑은 대상. 문자열은 모두 연결 arena 에 있음
+typedef struct {
+    char *host, *path, *port;
+    char *key;      // host:port/path
+    int purge;      // PURGE 요청 (캐시에서 빼기만 하고 서버로는 안 감)
+    char *range;    // Range / If-Range 값 (없으면 NULL). origin 으로는 빼고 보냄 (항상 전체 객체)
+    char *if_range;
+} Req;
+
+// 캐시에 넣을 응답 누적 버퍼. 필요한 만큼만 키움
+// flight 리더면 버퍼 대신 flight 에 바로 덧붙임 (따라온 요청들이 받는 대로 읽음)
+typedef struct {
     char *data;
-    size_t size;
-    struct Entry *prev, *next;        // LRU Doubly구조 
-    _Atomic unsigned long last_use;   // Lazy LRU 최근 접근 틱
-} Entry;
+    size_t len, cap;
+    int cacheable;    // 응답 헤더가 저장을 허락하고 크기도 맞음
+    int negative;     // 404/410: 짧게만 저장 (입장 심사 없이, 디스크에는 안 씀)
+    time_t expires;   // 응답 헤더로 계산한 만료 시각
+    size_t got;       // 서버에서 받은 바이트 (헤더 포함, 저장을 포기한 뒤에도 셈)
+    size_t want;      // 헤더 + Content-Length. 0 이면 길이를 모름 (닫힐 때까지)
+    uint64_t epoch;   // 요청 전 cache_epoch (flight 없이 저장할 때, 그 사이 PURGE 면 버림)
+    Flight *flight;
+} RespBuf;
+
+static pthread_attr_t g_thread_attr;   // 연결/워커 스레드 생성 속성 (스택 크기)
+
+static void doit_proxy(int clientfd, Arena *a);
+static int parse_request(Arena *a, const char *line, Req *req);
+static void parse_uri(const char *uri, char *host, char *path, char *port);
+static void request_headers(rio_t *client_rio, char *line, Arena *a, Req *req, Str *hdrs, int *has_host);
+static void filter_header(Arena *a, Req *req, Str *hdrs, const char *line, size_t len, int *has_host);
+static char *build_request(Arena *a, const char *path, const char *host,
+                           const char *hdrs, int has_host, int *outlen);
+static void *handle_mul_cli(void * arg);
+static size_t parse_size(const char *s);
+static char *local_response(Arena *a, const Req *req, size_t *len);
+static char *purge_response(Arena *a, int clientfd, const Req *req, size_t *len);
+static char *text_response(Arena *a, const char *status, const char *body, size_t blen, size_t *len);
+static int peer_is_local(int fd);
+
+/* Range 요청: 캐시에 있는 전체 응답 (200) 에서 잘라 206 / 416 으로 답함.
+  캐시에 없으면 전체 객체는 재검증 스레드가 받아 채우고, 그 요청 자체는 Range 를 그대로 origin 에 보냄 */
+static int range_response(Arena *a, const Req *req, const CacheObj *obj,
+                          char **head, size_t *hlen, const char **body, size_t *blen);
+static void send_cached(int clientfd, Arena *a, const Req *req, CacheObj *obj);
+static int range_follow(const Req *req, int role, Flight *f, CacheObj *stale);
+static int range_wait(int clientfd, Arena *a, const Req *req, Flight *f);
+static CacheObj *range_filled(const Req *req);
+static void range_headers(Arena *a, const Req *req, Str *hdrs);
 
+/* 제어 소켓 (-C path): 로컬 Unix 소켓에 한 줄 명령
+  "invalidate tag <tag>...", "purge key <key>", "purge prefix <prefix>" -> "OK <뺀 수>" 또는 "ERR ...".
+  접근 제어는 소켓 파일 권한 (0600) */
+static int open_controlfd(const char *path);
+static void *control_loop(void *arg);
+
+/* 워커 프로세스 (-w): 리스닝 소켓을 연 뒤 fork. 캐시를 공유하려면 -S 로 2단 계층을 공유 메모리에 */
+static void run_workers(int n);
+static void control_command(char *line, char *out, size_t outlen);
+
+/* 리스닝 소켓 샤드 (-s)
+  SO_REUSEPORT 로 같은 포트에 소켓을 여러 개 열면 커널이 새 연결을 나눠줌 */
 typedef struct {
-    Entry *head;   // MRU
-    Entry *tail;   // LRU
-    size_t bytes_used;
-    pthread_rwlock_t rw;
-} Cache;
+    int listenfd;
+    int cpu;        // 고정할 코어 (-1 이면 고정 안 함)
+} Shard;
 
-// 전역 캐시 초기화 
-static Cache g_cache = {
-    .head = NULL, .tail = NULL, .bytes_used = 0,
-    .rw = PTHREAD_RWLOCK_INITIALIZER
-};
+static int open_listenfd_reuseport(char *port);
+static void pin_to_cpu(int cpu);
+static void *acceptor(void *arg);
+static void run_event_loops(Shard *shards, int nshards, int nloops);
 
-// 전역 타임스탬프
-static _Atomic unsigned long g_ticks = 1;
+/* io_uring relay 백엔드 (-u). 워커 스레드마다 링 하나, 못 쓰면 rio 경로 */
+static int g_use_uring = 0;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_once = PTHREAD_ONCE_INIT;
+static _Atomic int g_ring_broken = 0;   // io_uring_setup 실패 후엔 다시 시도 안 함
 
-static int get_cache(const char *key, char **out_data, size_t *out_size);
+static uring_t *thread_ring(void);
+static void resp_append(RespBuf *rb, const char *data, size_t n);
+static int stream_flight(int clientfd, Flight *f);
+static int add_validators(Arena *a, Str *hdrs, CacheObj *stale);
+static int response_headers(rio_t *server_rio, char *line, Arena *a, Str *rh);
+static int resp_headers(RespBuf *rb, const char *key, const char *hdr, size_t len, CacheObj *stale);
+static void resp_finish(RespBuf *rb, const char *key, int ok);
+static void resp_nostore(RespBuf *rb);
+static time_t resp_expires(const HttpMeta *m, time_t now);
+static int relay_uring(uring_t *r, int serverfd, int clientfd, RespBuf *rb);
 
-/* You won't lose style points for including this long line in your code */
-static const char *user_agent_hdr =
-    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 "
-    "Firefox/10.0.3\r\n";
+/* 만료된 응답 재사용 (stale-while-revalidate / stale-if-error).
+  응답에 지시어가 없으면 g_stale_grace 초 (-g, 기본 0 = 쓰지 않음) */
+static long g_stale_grace = 0;
+enum { FETCH_OK, FETCH_ERROR, FETCH_UNREACHABLE };
 
-static void doit_proxy(int clientfd);
-static void parse_uri(const char *uri, char *host, char *path, char *port);
-static void request_headers(rio_t *client_rio, char *host, char *hdr_buf, size_t hdr_bufsz, int *has_host);
-static void *handle_mul_cli(void * arg);
+/* negative caching (-N 초, 0 이면 끔): 404/410 응답과 DNS/연결 실패한 origin 을 짧게 기억.
+  연결 실패는 "host:port" 키로 502 응답을 넣어 둠 (URL 키는 항상 '/' 가 붙으므로 겹치지 않음) */
+static long g_neg_ttl = NEG_TTL_DEFAULT;
+
+static int origin_down(Arena *a, const Req *req);
+static void origin_mark_down(Arena *a, const Req *req);
+static char *bad_gateway(Arena *a, const Req *req, size_t *len);
+
+static int fetch_origin(int clientfd, Arena *a, char *buf, const Req *req, const char *request,
+                        int reqlen, RespBuf *rb, CacheObj *stale, int revalidate);
+static void origin_error(int clientfd, Arena *a, RespBuf *rb, const Req *req, CacheObj *stale,
+                         int unreachable);
+static int stale_usable(CacheObj *obj, int on_error);
+static int origin_5xx(const char *hdr, size_t len);
+static void refresh_submit(const Req *req, Flight *f, CacheObj *stale);
+
+/* 워커 스레드 풀 (-t) 용 bounded 연결 큐 (CS:APP sbuf)
+  큐가 가득 차면 accept 하는 쪽이 막혀서 backpressure 가 걸림 */
+typedef struct {
+    int *buf;       // 연결 fd 원형 버퍼
+    int n;          // 최대 슬롯 수
+    int front;      // buf[(front+1)%n] 이 첫 원소
+    int rear;       // buf[rear%n] 이 마지막 원소
+    sem_t mutex;
+    sem_t slots;    // 빈 슬롯 수
+    sem_t items;    // 대기 중인 연결 수
+} sbuf_t;
+
+static sbuf_t g_sbuf;
+static int g_use_pool = 0;   // acceptor 가 풀 큐에 넣을지, 스레드를 만들지
+
+static void sbuf_init(sbuf_t *sp, int n);
+static void sbuf_insert(sbuf_t *sp, int item);
+static int sbuf_remove(sbuf_t *sp);
+static void *pool_worker(void *arg);
 
 int main(int argc, char **argv) {
+  int nloops = 0;     // -e: epoll 이벤트 루프 수 (0이면 thread-per-connection)
+  int nthreads = 0;   // -t: 워커 풀 크기 (0이면 연결마다 스레드 생성)
+  int qdepth = 0;     // -q: 연결 큐 깊이 (기본 LISTENQ)
+  int nshards = 0;    // -s: SO_REUSEPORT 리스너 수 (0이면 리스너 하나)
+  int stack_kb = DEFAULT_STACK_KB;   // -k: 스레드 스택 크기 (KB)
+  int cache_shards = CACHE_DEFAULT_SHARDS;   // -n: 캐시 샤드 수
+  size_t cache_bytes = MAX_CACHE_SIZE;       // -m: 캐시 전체 예산
+  size_t object_bytes = MAX_OBJECT_SIZE;     // -o: 객체 하나 상한
+  char *disk_path = NULL;                    // -D: 디스크 계층 파일 (없으면 메모리만)
+  size_t disk_bytes = DISK_DEFAULT_SIZE;     // -Z: 디스크 계층 크기
+  int bad_policy = 0;                        // -P: 교체 정책
+  double ahead_frac = 0;                     // -A: 수명의 이 비율이 지나면 뜨거운 객체를 미리 갱신
+  int ahead_hits = REFRESH_AHEAD_HITS;       // -H: 그러려면 수명 동안 필요한 히트 수
+  char *control_path = NULL;                 // -C: 제어 소켓 경로
+  char *shm_name = NULL;                     // -S: 공유 메모리 2단 계층 이름 (-Z 크기)
+  int nworkers = 0;                          // -w: 워커 프로세스 수 (0 이면 이 프로세스 하나)
+  int opt;
 
-  if (argc != 2) {
-      fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+  while ((opt = getopt(argc, argv, "e:t:q:s:uk:n:m:o:D:Z:P:g:A:H:N:C:S:w:")) != -1) {
+      switch (opt) {
+      case 'e': nloops = atoi(optarg); break;
+      case 't': nthreads = atoi(optarg); break;
+      case 'q': qdepth = atoi(optarg); break;
+      case 's': nshards = atoi(optarg); break;
+      case 'u': g_use_uring = 1; break;
+      case 'k': stack_kb = atoi(optarg); break;
+      case 'n': cache_shards = atoi(optarg); break;
+      case 'm': cache_bytes = parse_size(optarg); break;
+      case 'o': object_bytes = parse_size(optarg); break;
+      case 'D': disk_path = optarg; break;
+      case 'Z': disk_bytes = parse_size(optarg); break;
+      case 'P': bad_policy = cache_set_policy(optarg) < 0; break;
+      case 'g': g_stale_grace = atol(optarg); break;
+      case 'A': ahead_frac = atof(optarg); break;
+      case 'H': ahead_hits = atoi(optarg); break;
+      case 'N': g_neg_ttl = atol(optarg); break;
+      case 'C': control_path = optarg; break;
+      case 'S': shm_name = optarg; break;
+      case 'w': nworkers = atoi(optarg); break;
+      default:  optind = argc + 1; break;
+      }
+  }
+  if (optind != argc - 1 || nloops < 0 || nthreads < 0 || qdepth < 0 || nshards < 0 ||
+      (nloops && nthreads) || stack_kb <= 0 || cache_shards <= 0 ||
+      !cache_bytes || !object_bytes || object_bytes > cache_bytes || !disk_bytes || bad_policy ||
+      g_stale_grace < 0 || g_neg_ttl < 0 || ahead_frac < 0 || ahead_frac >= 1 || ahead_hits <= 0 ||
+      nworkers < 0 || (disk_path && (shm_name || nworkers))) {
+      fprintf(stderr, "Usage: %s [-e loops | -t threads [-q depth]] [-s shards] [-u] [-k stack_kb]"
+              " [-n cache_shards] [-m cache_size] [-o object_size] [-P policy] [-g stale_secs] [-N neg_secs]"
+              " [-A ahead_frac [-H ahead_hits]] [-D disk_file | -S shm_name] [-Z disk_size] [-w workers]"
+              " [-C control_socket] <port>\n"
+              "  sizes accept K/M/G suffixes, e.g. -m 32G -o 64M\n"
+              "  policy: %s (default clock)\n"
+              "  -g: serve expired entries this long while revalidating or when the origin fails\n"
+              "  -A: refetch entries hit -H times (default %d) once this fraction of their TTL has passed\n"
+              "  -N: remember 404/410 responses and unreachable origins this long (default %d, 0 = off)\n"
+              "  -S: keep the second tier in POSIX shared memory so -w workers (or other proxies) share it\n"
+              "  -C: unix socket taking \"invalidate tag <tag>\", \"purge key <key>\", \"purge prefix <prefix>\"\n",
+              argv[0], cache_policy_names(), REFRESH_AHEAD_HITS, NEG_TTL_DEFAULT);
       exit(1);
   }
 
-  int listenfd = Open_listenfd(argv[1]);
+  // 요청 버퍼는 arena 에 있으므로 스레드 스택은 작게
+  pthread_attr_init(&g_thread_attr);
+  int rc = pthread_attr_setstacksize(&g_thread_attr, (size_t)stack_kb * 1024);
+  if (rc) posix_error(rc, "pthread_attr_setstacksize error");
+
+  cache_set_refresh_ahead(ahead_frac, (unsigned)ahead_hits);
+  cache_init(cache_bytes, object_bytes, cache_shards);
+  // 파일 안에 인덱스까지 있으므로 재시작해도 바로 이전 내용으로 시작
+  if (disk_path && disk_open(disk_path, disk_bytes) < 0) unix_error("disk_open error");
+  if (shm_name && disk_open_shared(shm_name, disk_bytes) < 0) unix_error("disk_open_shared error");
+
+  // 끊긴 클라이언트에 write 해도 프로세스가 죽지 않도록
+  Signal(SIGPIPE, SIG_IGN);
+
+  int controlfd = -1;
+  if (control_path && (controlfd = open_controlfd(control_path)) < 0) unix_error("open_controlfd error");
+
+  // 샤드마다 자기 리스닝 소켓, 샤드 i 는 코어 i 에 고정
+  int nlisten = nshards ? nshards : 1;
+  Shard *shards = Calloc(nlisten, sizeof(Shard));
+  for (int i = 0; i < nlisten; i++) {
+      if (nshards) {
+          shards[i].listenfd = open_listenfd_reuseport(argv[optind]);
+          if (shards[i].listenfd < 0) unix_error("open_listenfd_reuseport error");
+          shards[i].cpu = i;
+      } else {
+          shards[i].listenfd = Open_listenfd(argv[optind]);
+          shards[i].cpu = -1;
+      }
+  }
+
+  // 소켓은 다 열어 두고 스레드는 아직 없을 때 fork (워커마다 아래부터 따로 돎)
+  if (nworkers > 0) run_workers(nworkers);
+  if (controlfd >= 0) {
+      int *cfd = Malloc(sizeof(int));
+      *cfd = controlfd;
+      pthread_t tid;
+      Pthread_create(&tid, NULL, control_loop, cfd);
+  }
+
+  if (nloops > 0) {
+      run_event_loops(shards, nlisten, nloops);   // 돌아오지 않음
+  }
+  if (nthreads > 0) {
+      // 워커를 미리 띄워두고 acceptor 는 큐에 fd 만 넣음
+      sbuf_init(&g_sbuf, qdepth ? qdepth : LISTENQ);
+      for (int i = 0; i < nthreads; i++) {
+          pthread_t tid;
+          Pthread_create(&tid, &g_thread_attr, pool_worker, NULL);
+      }
+      g_use_pool = 1;
+  }
+  for (int i = 1; i < nlisten; i++) {
+      pthread_t tid;
+      Pthread_create(&tid, NULL, acceptor, &shards[i]);
+  }
+  acceptor(&shards[0]);
+}
+
+// 워커 n 개를 띄우고 부모는 감시만 함 (죽은 워커는 다시 띄움). 워커에서만 돌아옴
+static void run_workers(int n) {
+    for (int i = 0; i < n; i++)
+        if (Fork() == 0) return;
+    for (;;) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            exit(0);
+        }
+        fprintf(stderr, "worker %d exited (status %d), restarting\n", (int)pid, status);
+        sleep(1);   // 시작하자마자 죽는 경우 fork 를 연달아 하지 않게
+        if (Fork() == 0) return;
+    }
+}
+
+// "512K", "64M", "32G" 같은 크기 인자. 잘못되면 0
+static size_t parse_size(const char *s) {
+  char *end;
+  unsigned long long v = strtoull(s, &end, 10);
+  switch (toupper((unsigned char)*end)) {
+  case 'G': v <<= 10; /* fall through */
+  case 'M': v <<= 10; /* fall through */
+  case 'K': v <<= 10; end++; break;
+  case '\0': break;
+  default: return 0;
+  }
+  if (*end) return 0;
+  return (size_t)v;
+}
+
+// 리스너 하나를 맡아 accept 만 반복
+static void *acceptor(void *arg) {
+  Shard *sh = arg;
+  pin_to_cpu(sh->cpu);
+
   while (1) {
       struct sockaddr_storage clientaddr;
       socklen_t clientlen = sizeof(clientaddr);
+      int fd = Accept(sh->listenfd, (SA *)&clientaddr, &clientlen);
+
+      if (g_use_pool) {
+          sbuf_insert(&g_sbuf, fd);   // 큐가 가득 차면 여기서 대기
+          continue;
+      }
+
       pthread_t tid;
       int *clientfd = malloc(sizeof(int));
-
-      *clientfd = Accept(listenfd, (SA *)&clientaddr, &clientlen);
+      *clientfd = fd;
 
       // handle multi client with thread
-      pthread_create(&tid, NULL, handle_mul_cli, clientfd );
+      if (pthread_create(&tid, &g_thread_attr, handle_mul_cli, clientfd) != 0) {
+          Close(fd);
+          free(clientfd);
+      }
   }
+  return(NULL);
+}
+
+// open_listenfd 와 같지만 SO_REUSEPORT 를 켜서 같은 포트에 여러 번 bind 가능
+static int open_listenfd_reuseport(char *port) {
+    struct addrinfo hints, *listp, *p;
+    int listenfd = -1, optval = 1;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG | AI_NUMERICSERV;
+    if (getaddrinfo(NULL, port, &hints, &listp) != 0) return -2;
+
+    for (p = listp; p; p = p->ai_next) {
+        if ((listenfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+            continue;
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int));
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int));
+        if (bind(listenfd, p->ai_addr, p->ai_addrlen) == 0)
+            break;
+        close(listenfd);
+    }
+    freeaddrinfo(listp);
+    if (!p) return -1;
+
+    if (listen(listenfd, LISTENQ) < 0) {
+        close(listenfd);
+        return -1;
+    }
+    return listenfd;
+}
+
+// 호출한 스레드를 cpu 번째 코어에 고정. 실패하면 알리고 고정 없이 계속
+static void pin_to_cpu(int cpu) {
+    if (cpu < 0) return;
+    int rc = affinity_pin(cpu);
+    if (rc != 0) fprintf(stderr, "cannot pin to cpu %d (%s), running unpinned\n", cpu, strerror(rc));
 }
 // void * 반환 
 static void *handle_mul_cli(void * arg) {
@@ -71,111 +386,947 @@ static void *handle_mul_cli(void * arg) {
   int clientfd = *(int *)arg;
   free(arg);
 
-  doit_proxy(clientfd);
+  Arena arena;
+  arena_init(&arena, ARENA_BLOCK);
+  doit_proxy(clientfd, &arena);
   Close(clientfd);
+  arena_free(&arena);
+
+  return(NULL);
+}
+
+static void *pool_worker(void *arg) {
+  (void)arg;
+  pthread_detach(pthread_self());
 
+  // 워커는 arena 하나를 연결마다 비워서 재사용
+  Arena arena;
+  arena_init(&arena, ARENA_BLOCK);
+  while (1) {
+      int clientfd = sbuf_remove(&g_sbuf);
+      doit_proxy(clientfd, &arena);
+      Close(clientfd);
+      arena_reset(&arena);
+  }
   return(NULL);
 }
 
-static void doit_proxy(int clientfd) {
-    rio_t rio_client;
-    Rio_readinitb(&rio_client, clientfd);
+static void sbuf_init(sbuf_t *sp, int n) {
+    sp->buf = Calloc(n, sizeof(int));
+    sp->n = n;
+    sp->front = sp->rear = 0;
+    Sem_init(&sp->mutex, 0, 1);
+    Sem_init(&sp->slots, 0, n);
+    Sem_init(&sp->items, 0, 0);
+}
+
+static void sbuf_insert(sbuf_t *sp, int item) {
+    P(&sp->slots);
+    P(&sp->mutex);
+    sp->buf[(++sp->rear) % (sp->n)] = item;
+    V(&sp->mutex);
+    V(&sp->items);
+}
+
+static int sbuf_remove(sbuf_t *sp) {
+    int item;
+    P(&sp->items);
+    P(&sp->mutex);
+    item = sp->buf[(++sp->front) % (sp->n)];
+    V(&sp->mutex);
+    V(&sp->slots);
+    return item;
+}
+
+static void doit_proxy(int clientfd, Arena *a) {
+    // 큰 버퍼는 스택 대신 연결 arena 에서
+    rio_t *rio_client = arena_alloc(a, sizeof(rio_t));
+    char *buf = arena_alloc(a, MAXLINE);   // 줄 읽기 + relay 버퍼로 재사용
+    if (!rio_client || !buf) return;
+    Rio_readinitb(rio_client, clientfd);
 
-    char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
-    if (Rio_readlineb(&rio_client, buf, sizeof(buf)) <= 0) return;
+    if (Rio_readlineb(rio_client, buf, MAXLINE) <= 0) return;
 
     /* Parse request line */
-    if (sscanf(buf, "%s %s %s", method, uri, version) != 3) return;
-    if (strcasecmp(method, "GET")) {
+    Req req;
+    if (parse_request(a, buf, &req) < 0) return;
+
+    // 나머지 headers 담기 (Range 는 히트에서도 봐야 하므로 캐시 조회 전에)
+    Str hdrs = {0};
+    int has_host = 0;
+    request_headers(rio_client, buf, a, &req, &hdrs, &has_host);
+
+    // 절대 URI 가 아니면 프록시 자신에게 온 요청 (통계 등), PURGE 는 캐시에서만 처리
+    if (!req.host[0] || req.purge) {
+        size_t len;
+        char *resp = req.host[0] ? purge_response(a, clientfd, &req, &len) : local_response(a, &req, &len);
+        if (resp) rio_writen(clientfd, resp, len);
+        return;
+    }
+     
+    // 같은 key 를 이미 누가 가져오는 중이면 받는 대로 따라 읽음 (single-flight)
+    Flight *flight;
+    CacheObj *cached;
+    int role = flight_join(req.key, &flight, &cached);
+    if (role == FLIGHT_HIT) {
+        // 캐시 히트시 복사 없이 캐시 객체를 바로 전송
+        send_cached(clientfd, a, &req, cached);
+        // 뜨거운 객체가 만료에 가까우면 만료 전에 백그라운드로 다시 받음 (참조는 넘김)
+        if (cache_ahead_due(cached)) refresh_submit(&req, NULL, cached);
+        else cache_release(cached);
+        return;
+    }
+    if (cached && stale_usable(cached, 0)) {
+        // stale-while-revalidate: 만료된 것을 바로 보내고, 갱신은 리더만 백그라운드로 넘김
+        send_cached(clientfd, a, &req, cached);
+        if (role == FLIGHT_LEAD) {
+            refresh_submit(&req, flight, cached);
+        } else {
+            flight_leave(flight);
+            cache_release(cached);
+        }
+        return;
+    }
+    if (req.range) {
+        // 전체 객체를 한 번만 받아 캐시에서 잘라 줌. 캐시에 못 들어가면 Range 를 붙여 직접
+        if (range_follow(&req, role, flight, cached) == 0 && range_wait(clientfd, a, &req, flight) == 0)
+            return;
+        range_headers(a, &req, &hdrs);
+        flight = NULL;
+        cached = NULL;
+    } else if (role == FLIGHT_FOLLOW) {
+        if (stream_flight(clientfd, flight) == 0) {
+            cache_release(cached);
+            return;
+        }
+        flight = NULL;   // 리더가 아무것도 못 받고 실패: 직접 가져오되 리더는 아님
+    }
+
+    // 여기부터 리더는 어떤 경로로 나가든 flight_finish 해야 함
+    // cached 가 남아 있으면 만료된 객체 -> 조건부 요청으로 재검증 (검증자가 없어도 실패 대비로 둠)
+    CacheObj *stale = cached;
+    RespBuf resp = { .cacheable = 1, .flight = flight };
+    int revalidate = stale && add_validators(a, &hdrs, stale);
+
+    int reqlen;
+    char *request_f = build_request(a, req.path, req.host, hdrs.s ? hdrs.s : "", has_host, &reqlen);
+    int r = request_f ? fetch_origin(clientfd, a, buf, &req, request_f, reqlen, &resp, stale, revalidate)
+                      : FETCH_ERROR;
+    if (r != FETCH_OK) origin_error(clientfd, a, &resp, &req, stale, r == FETCH_UNREACHABLE);
+    cache_release(stale);
+    free(resp.data);
+}
+
+/* 서버에 request 를 보내고 응답을 clientfd 로 흘리면서 rb 에 모음 (clientfd < 0 이면 캐시/flight 만 채움).
+  revalidate 면 stale 을 조건부 요청 중이라 304 가 오면 stale 로 응답.
+  클라이언트에 아무것도 보내기 전에 서버가 실패하면 (요청 실패, 빈 응답, stale 을 쓸 수 있는 5xx)
+  rb 를 끝내지 않고 FETCH_ERROR, DNS/연결 실패면 FETCH_UNREACHABLE (호출자가 origin_error).
+  그 외엔 rb 를 끝내고 FETCH_OK */
+static int fetch_origin(int clientfd, Arena *a, char *buf, const Req *req, const char *request,
+                        int reqlen, RespBuf *rb, CacheObj *stale, int revalidate) {
+    // 방금 연결 실패한 origin 이면 DNS/connect 를 반복하지 않음
+    if (origin_down(a, req)) return FETCH_UNREACHABLE;
+    rb->epoch = cache_epoch(req->key);
+    int serverfd = open_clientfd(req->host, req->port);
+    if (serverfd < 0) {
+        origin_mark_down(a, req);
+        return FETCH_UNREACHABLE;
+    }
+
+    // 응답 헤더까지 먼저 읽어서 저장 여부 / 304 판단
+    rio_t *rio_server = arena_alloc(a, sizeof(rio_t));
+    Str rh = {0};
+    int whole;
+    if (!rio_server || rio_writen(serverfd, (void *)request, (size_t)reqlen) < 0) goto error;
+    Rio_readinitb(rio_server, serverfd);
+    if ((whole = response_headers(rio_server, buf, a, &rh)) < 0 || !rh.len) goto error;
+    if (stale && origin_5xx(rh.s, rh.len) && stale_usable(stale, 1)) goto error;
+
+    if (resp_headers(rb, req->key, rh.s, rh.len, revalidate && whole ? stale : NULL)) {
+        // 304: 본문은 다시 받지 않고 저장된 응답으로
+        Close(serverfd);
+        if (clientfd >= 0) rio_writen(clientfd, stale->data, stale->size);
+        if (rb->flight) flight_append(rb->flight, stale->data, stale->size);
+        rb->cacheable = 0;
+        resp_finish(rb, req->key, 1);
+        return FETCH_OK;
+    }
+    if (!whole) resp_nostore(rb);   // 헤더 끝 전에 닫힘: 받은 것만 넘기고 저장은 안 함
+
+    if (clientfd < 0 && !rb->cacheable) {
+        // 받을 클라이언트가 없고 (재검증 스레드) 저장도 못 함: 본문은 받지 않음
+        Close(serverfd);
+        resp_finish(rb, req->key, 1);
+        return FETCH_OK;
+    }
+
+    int ok = 1;
+    if (clientfd >= 0 && rio_writen(clientfd, rh.s, rh.len) < 0) ok = 0;
+    resp_append(rb, rh.s, rh.len);
+
+    uring_t *ring = clientfd >= 0 ? thread_ring() : NULL;
+    if (!ok) {
+        // 클라이언트가 끊김
+    } else if (ring) {
+      // 헤더와 같이 rio 버퍼로 들어온 본문 앞부분부터 (링은 fd 를 직접 읽음)
+      if (rio_server->rio_cnt > 0) {
+          if (rio_writen(clientfd, rio_server->rio_bufptr, rio_server->rio_cnt) < 0) ok = 0;
+          resp_append(rb, rio_server->rio_bufptr, (size_t)rio_server->rio_cnt);
+          rio_server->rio_cnt = 0;
+      }
+      if (ok && relay_uring(ring, serverfd, clientfd, rb) < 0)
+          ok = 0;
+    } else {
+      ssize_t cnt;
+
+      while ((cnt = rio_readnb(rio_server, buf, MAXLINE)) > 0) {
+        if (clientfd >= 0 && rio_writen(clientfd, buf, cnt) < 0) {
+            ok = 0;
+            break;
+        }
+        resp_append(rb, buf, (size_t)cnt);
+      }
+      if (cnt < 0) ok = 0;
+    }
+    Close(serverfd);
+
+    resp_finish(rb, req->key, ok);
+    return FETCH_OK;
+
+error:
+    Close(serverfd);
+    return FETCH_ERROR;
+}
+
+/* 서버 실패로 아직 아무것도 못 보냄: stale-if-error 창 안이면 저장된 응답으로, 아니면 실패로 끝냄.
+  origin 에 닿지도 못했으면 클라이언트에 502 */
+static void origin_error(int clientfd, Arena *a, RespBuf *rb, const Req *req, CacheObj *stale,
+                         int unreachable) {
+    if (stale && stale_usable(stale, 1)) {
+        if (clientfd >= 0) rio_writen(clientfd, stale->data, stale->size);
+        if (rb->flight) flight_append(rb->flight, stale->data, stale->size);
+        rb->cacheable = 0;
+        resp_finish(rb, req->key, 1);
         return;
     }
+    resp_finish(rb, req->key, 0);
+
+    size_t len;
+    char *resp;
+    if (unreachable && clientfd >= 0 && (resp = bad_gateway(a, req, &len)))
+        rio_writen(clientfd, resp, len);
+}
+
+// 연결 실패한 origin 을 기억하는 키 "host:port" (URL 키의 앞부분)
+static char *origin_key(Arena *a, const Req *req) {
+    size_t n = strlen(req->host) + 1 + strlen(req->port);
+    char *k = arena_alloc(a, n + 1);
+    if (!k) return NULL;
+    memcpy(k, req->key, n);
+    k[n] = '\0';
+    return k;
+}
+
+// 최근 g_neg_ttl 안에 DNS/연결 실패한 origin 인가
+static int origin_down(Arena *a, const Req *req) {
+    char *k;
+    if (!g_neg_ttl || !(k = origin_key(a, req))) return 0;
+    CacheObj *obj = get_cache(k);
+    if (!obj) return 0;
+    int down = atomic_load_explicit(&obj->expires, memory_order_relaxed) > time(NULL);
+    cache_release(obj);
+    return down;
+}
+
+static void origin_mark_down(Arena *a, const Req *req) {
+    char *k, *resp;
+    size_t len;
+    if (!g_neg_ttl || !(k = origin_key(a, req)) || !(resp = bad_gateway(a, req, &len))) return;
+    put_cache_negative(k, resp, len, time(NULL) + g_neg_ttl);
+}
+
+// origin 에 닿지 못했을 때 클라이언트에 보낼 응답
+static char *bad_gateway(Arena *a, const Req *req, size_t *len) {
+    char body[MAXLINE];
+    int blen = snprintf(body, sizeof(body), "Cannot reach %s:%s\n", req->host, req->port);
+    if (blen < 0 || blen >= (int)sizeof(body)) return NULL;
+    size_t cap = (size_t)blen + 128;
+    char *resp = arena_alloc(a, cap);
+    if (!resp) return NULL;
+    int n = snprintf(resp, cap, "HTTP/1.0 502 Bad Gateway\r\nContent-Type: text/plain\r\n"
+                     "Content-Length: %d\r\n\r\n%s", blen, body);
+    *len = (size_t)n;
+    return resp;
+}
+
+// 만료된 obj 를 지금 그대로 보내도 되는가 (on_error: 서버 실패 때 / 아니면 백그라운드 재검증 동안)
+static int stale_usable(CacheObj *obj, int on_error) {
+    HttpMeta m;
+    size_t end = http_header_end(obj->data, obj->size);
+    if (!end || http_parse_response(obj->data, end, &m) < 0) return 0;
+    time_t expires = atomic_load_explicit(&obj->expires, memory_order_relaxed);
+    return time(NULL) < http_stale_until(&m, expires, g_stale_grace, on_error);
+}
+
+static int origin_5xx(const char *hdr, size_t len) {
+    HttpMeta m;
+    return http_parse_response(hdr, len, &m) == 0 && m.status >= 500;
+}
+
+/* 백그라운드 재검증 (stale-while-revalidate, 미리 갱신)
+  저장된 응답으로 이미 응답한 요청에게서 flight 리더 역할 (있으면) 과 객체 참조를 넘겨받아
+  서버에서 다시 받고 캐시를 갈아 끼움 (304 면 수명만 늘림). 교체는 put_cache 가 샤드 쓰기 락 안에서
+  하므로 그동안 히트는 계속 옛 객체로 나감. 이벤트 루프를 막지 않도록 전용 스레드에서 blocking 으로 */
+typedef struct RefreshJob {
+    struct RefreshJob *next;
+    Flight *flight;      // 넘겨받은 리더 몫 (NULL 이면 혼자 가져옴)
+    CacheObj *stale;     // 검증자 출처, 실패 시 대신 보낼 것 (미리 갱신이면 아직 신선)
+    Req req;             // 문자열은 job 뒤에 같이 할당
+} RefreshJob;
+
+static struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cond;
+    RefreshJob *head, *tail;
+    int len;
+} g_refresh = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0 };
+static pthread_once_t g_refresh_once = PTHREAD_ONCE_INIT;
+
+static void refresh_run(RefreshJob *j, Arena *a) {
+    char *buf = arena_alloc(a, MAXLINE);
+    Str hdrs = {0};
+    RespBuf rb = { .cacheable = 1, .flight = j->flight };
+    int revalidate = j->stale && add_validators(a, &hdrs, j->stale);
+    int reqlen;
+    char *request = buf ? build_request(a, j->req.path, j->req.host, hdrs.s ? hdrs.s : "", 0, &reqlen) : NULL;
+    int r = request ? fetch_origin(-1, a, buf, &j->req, request, reqlen, &rb, j->stale, revalidate)
+                    : FETCH_ERROR;
+
+    if (r != FETCH_OK) origin_error(-1, a, &rb, &j->req, j->stale, r == FETCH_UNREACHABLE);
+    free(rb.data);
+    cache_release(j->stale);
+    free(j);
+}
+
+static void *refresh_worker(void *arg) {
+    (void)arg;
+    pthread_detach(pthread_self());
+    Arena arena;
+    arena_init(&arena, ARENA_BLOCK);
+    while (1) {
+        pthread_mutex_lock(&g_refresh.mu);
+        while (!g_refresh.head) pthread_cond_wait(&g_refresh.cond, &g_refresh.mu);
+        RefreshJob *j = g_refresh.head;
+        if (!(g_refresh.head = j->next)) g_refresh.tail = NULL;
+        g_refresh.len--;
+        pthread_mutex_unlock(&g_refresh.mu);
+
+        refresh_run(j, &arena);
+        arena_reset(&arena);
+    }
+    return NULL;
+}
+
+static void refresh_start(void) {
+    for (int i = 0; i < REFRESH_WORKERS; i++) {
+        pthread_t tid;
+        Pthread_create(&tid, &g_thread_attr, refresh_worker, NULL);
+    }
+}
+
+// flight (리더 몫) 와 stale 참조를 넘겨받음. 큐가 넘치면 갱신을 포기하고 flight 를 실패로 끝냄
+static void refresh_submit(const Req *req, Flight *f, CacheObj *stale) {
+    pthread_once(&g_refresh_once, refresh_start);
+
+    size_t lh = strlen(req->host) + 1, lp = strlen(req->port) + 1;
+    size_t lpath = strlen(req->path) + 1, lk = strlen(req->key) + 1;
+    RefreshJob *j = malloc(sizeof(*j) + lh + lp + lpath + lk);
+    if (j) {
+        char *p = (char *)(j + 1);
+        j->req = (Req){0};
+        j->req.host = memcpy(p, req->host, lh);
+        j->req.port = memcpy(p += lh, req->port, lp);
+        j->req.path = memcpy(p += lp, req->path, lpath);
+        j->req.key = memcpy(p += lpath, req->key, lk);
+        j->flight = f;
+        j->stale = stale;
+        j->next = NULL;
+    }
+
+    int queued = 0;
+    pthread_mutex_lock(&g_refresh.mu);
+    if (j && g_refresh.len < REFRESH_QUEUE_MAX) {
+        if (g_refresh.tail) g_refresh.tail->next = j;
+        else g_refresh.head = j;
+        g_refresh.tail = j;
+        g_refresh.len++;
+        pthread_cond_signal(&g_refresh.cond);
+        queued = 1;
+    }
+    pthread_mutex_unlock(&g_refresh.mu);
+    if (queued) return;
+
+    free(j);
+    if (f) flight_finish(f, FLIGHT_FAIL, 0);
+    cache_release(stale);
+}
+
+// 다 받은 응답을 캐시에: flight 리더면 따라온 요청들에게도 끝을 알림
+static void resp_finish(RespBuf *rb, const char *key, int ok) {
+    // Content-Length 보다 덜 받고 닫힘 (FIN 으로 정상 종료여도): 잘린 응답은 저장하지 않음
+    if (rb->want && rb->got != rb->want) ok = 0;
+    if (rb->flight) {
+        flight_finish(rb->flight, !ok ? FLIGHT_FAIL : !rb->cacheable ? FLIGHT_NOSTORE :
+                                  rb->negative ? FLIGHT_STORE_NEG : FLIGHT_STORE, rb->expires);
+        rb->flight = NULL;
+    } else if (ok && rb->cacheable) {
+        // 헤더+바디 전체 넣기 
+        put_cache_since(key, rb->data, rb->len, rb->expires, rb->negative, rb->epoch);
+    }
+}
+
+/* 서버 응답 헤더 블록이 다 모였을 때: 저장 여부와 만료 시각 결정.
+  stale 을 재검증하는 중이고 304 가 왔으면 stale 의 수명을 늘리고 1 (호출자가 stale 로 응답) */
+static int resp_headers(RespBuf *rb, const char *key, const char *hdr, size_t len, CacheObj *stale) {
+    HttpMeta m;
+    time_t now = time(NULL);
+
+    if (http_parse_response(hdr, len, &m) == 0 && stale && m.status == 304) {
+        // 304 에 수명 정보가 없으면 저장된 응답의 Cache-Control/Expires 를 그대로 씀
+        if (m.s_maxage < 0 && m.max_age < 0 && !m.expires && !m.no_cache) {
+            HttpMeta old;
+            size_t end = http_header_end(stale->data, stale->size);
+            if (end && http_parse_response(stale->data, end, &old) == 0) {
+                if (old.expires && old.date) old.expires += (m.date ? m.date : now) - old.date;
+                old.date = m.date;
+                old.age = m.age;
+                m = old;
+            }
+        }
+        cache_refresh(key, stale, resp_expires(&m, now));
+        return 1;
+    }
+
+    if (!http_storable(&m) || (http_negative(&m) && !g_neg_ttl) ||
+        (m.content_length >= 0 && (unsigned long long)m.content_length + len > cache_max_object())) {
+        // 200/404/410 이 아니거나 no-store/private, 또는 본문이 상한보다 큼
+        resp_nostore(rb);
+        return 0;
+    }
+    if (m.content_length >= 0) rb->want = len + (size_t)m.content_length;
+    rb->expires = resp_expires(&m, now);
+    rb->negative = http_negative(&m);
+    return 0;
+}
+
+// 저장도, 따라온 요청과 공유도 하지 않음 (따라온 요청은 직접 가져감)
+static void resp_nostore(RespBuf *rb) {
+    rb->cacheable = 0;
+    if (rb->flight) {
+        flight_finish(rb->flight, FLIGHT_FAIL, 0);
+        rb->flight = NULL;
+    }
+}
+
+// 404/410 은 수명이 명시되지 않았으면 휴리스틱 대신 g_neg_ttl
+static time_t resp_expires(const HttpMeta *m, time_t now) {
+    return http_negative(m) ? http_negative_expires_at(m, now, g_neg_ttl) : http_expires_at(m, now);
+}
+
+// 저장된 응답의 ETag / Last-Modified 로 조건부 요청 헤더를 붙임. 붙일 게 없으면 0
+static int add_validators(Arena *a, Str *hdrs, CacheObj *stale) {
+    HttpMeta m;
+    size_t end = http_header_end(stale->data, stale->size);
+    if (!end || http_parse_response(stale->data, end, &m) < 0) return 0;
+
+    int added = 0;
+    if (m.etag) {
+        str_append(a, hdrs, "If-None-Match: ", 15);
+        str_append(a, hdrs, m.etag, m.etag_len);
+        str_append(a, hdrs, "\r\n", 2);
+        added = 1;
+    }
+    if (m.lastmod) {
+        str_append(a, hdrs, "If-Modified-Since: ", 19);
+        str_append(a, hdrs, m.lastmod, m.lastmod_len);
+        str_append(a, hdrs, "\r\n", 2);
+        added = 1;
+    }
+    return added;
+}
+
+/* 서버 응답 헤더를 빈 줄까지 rh 에 모음. line 은 MAXLINE 줄 버퍼.
+  빈 줄까지 받았으면 1, 그 전에 서버가 닫았으면 0 (받은 만큼만 rh 에), 너무 크면 -1 */
+static int response_headers(rio_t *server_rio, char *line, Arena *a, Str *rh) {
+    ssize_t n;
+    while ((n = rio_readlineb(server_rio, line, MAXLINE)) > 0) {
+        if (rh->len + (size_t)n > RESP_HDR_MAX || str_append(a, rh, line, (size_t)n) < 0) return -1;
+        if (!strcmp(line, "\r\n") || !strcmp(line, "\n")) return 1;   // 헤더 끝
+    }
+    if (n < 0) return -1;
+    if (!rh->s && str_append(a, rh, "", 0) < 0) return -1;   // 빈 응답
+    return 0;
+}
+
+/* 리더가 채우는 flight 를 처음부터 클라이언트로 흘려보냄.
+  한 바이트도 보내기 전에 리더가 실패했거나 응답이 객체 상한을 넘었으면 -1 (직접 가져오라는 뜻), 그 외 0 */
+static int stream_flight(int clientfd, Flight *f) {
+    size_t off = 0;
+    const char *p;
+    long n;
+
+    while ((n = flight_read(f, off, &p, NULL)) > 0) {
+        if (rio_writen(clientfd, (void *)p, (size_t)n) < 0) break;
+        off += (size_t)n;
+    }
+    flight_leave(f);
+    return (n == FLIGHT_ERR && off == 0) ? -1 : 0;
+}
+
+//캐시 버퍼에 누적 (객체 상한 넘으면 캐시 포기)
+static void resp_append(RespBuf *rb, const char *data, size_t n) {
+    rb->got += n;
+    if (rb->flight) {
+        flight_append(rb->flight, data, n);   // 크기 상한은 flight 가 판단
+        return;
+    }
+    if (!rb->cacheable) return;
+    size_t max_object = cache_max_object();
+    if (rb->len + n > max_object) {
+        rb->cacheable = 0;
+        return;
+    }
+    if (rb->len + n > rb->cap) {
+        // 처음부터 상한만큼 잡지 않고 두 배씩
+        size_t cap = rb->cap ? rb->cap : MAXLINE;
+        while (cap < rb->len + n) cap *= 2;
+        if (cap > max_object) cap = max_object;
+        char *p = realloc(rb->data, cap);
+        if (!p) { rb->cacheable = 0; return; }
+        rb->data = p;
+        rb->cap = cap;
+    }
+    memcpy(rb->data + rb->len, data, n);
+    rb->len += n;
+}
+
+static void ring_destroy(void *p) {
+    uring_free(p);
+    free(p);
+}
+
+static void ring_key_init(void) {
+    pthread_key_create(&g_ring_key, ring_destroy);   // 스레드 종료 시 링 정리
+}
+
+// 호출한 스레드의 링. io_uring 을 못 쓰면 NULL
+static uring_t *thread_ring(void) {
+    if (!g_use_uring || atomic_load(&g_ring_broken)) return NULL;
+    pthread_once(&g_ring_once, ring_key_init);
+
+    uring_t *r = pthread_getspecific(g_ring_key);
+    if (r) return r;
+    if (!(r = malloc(sizeof(*r)))) return NULL;
+    if (uring_init(r, 8) < 0) {
+        if (!atomic_exchange(&g_ring_broken, 1))
+            fprintf(stderr, "io_uring unavailable (%s), falling back to read/write\n", strerror(errno));
+        free(r);
+        return NULL;
+    }
+    pthread_setspecific(g_ring_key, r);
+    return r;
+}
+
+// 링 상태를 알 수 없게 되면 버리고 다음 요청에서 새로 만듦
+static void thread_ring_drop(uring_t *r) {
+    pthread_setspecific(g_ring_key, NULL);
+    ring_destroy(r);
+}
+
+/* 서버 응답 relay (io_uring)
+  등록 버퍼 두 개를 번갈아 쓰면서, 이번 조각 write 와 다음 조각 read 를
+  한 번의 io_uring_enter 로 제출 -> 조각당 시스템 콜 2번이 1번으로 */
+static int relay_uring(uring_t *r, int serverfd, int clientfd, RespBuf *rb) {
+    enum { UD_READ = 1, UD_WRITE = 2 };
+    unsigned long long ud;
+    int res, rres = 0, wres = 0;
+    int cur = 0;
+
+    uring_prep_read_fixed(r, serverfd, cur, URING_BUFSZ, UD_READ);
+    if (uring_submit_wait(r, 1) < 0 || !uring_reap(r, &ud, &rres)) {
+        thread_ring_drop(r);
+        return -1;
+    }
+
+    while (rres > 0) {
+        size_t n = (size_t)rres;
+        uring_prep_write_fixed(r, clientfd, cur, 0, n, UD_WRITE);
+        uring_prep_read_fixed(r, serverfd, cur ^ 1, URING_BUFSZ, UD_READ);
+        if (uring_submit_wait(r, 2) < 0) {
+            thread_ring_drop(r);
+            return -1;
+        }
+        // 커널이 버퍼를 쓰는 동안 읽기만 하므로 안전
+        resp_append(rb, uring_buf(r, cur), n);
+
+        for (int got = 0; got < 2; got++) {
+            if (!uring_reap(r, &ud, &res)) {
+                thread_ring_drop(r);
+                return -1;
+            }
+            if (ud == UD_READ) rres = res;
+            else wres = res;
+        }
+        if (wres < 0) return -1;
+        // 짧게 써졌으면 나머지는 동기 write 로
+        if ((size_t)wres < n && rio_writen(clientfd, uring_buf(r, cur) + wres, n - wres) < 0)
+            return -1;
+        cur ^= 1;
+    }
+    return rres < 0 ? -1 : 0;
+}
+
+// 요청 라인 "GET uri version" 파싱. 대상 문자열은 uri 길이만큼만 arena 에. GET 이 아니면 -1
+static int parse_request(Arena *a, const char *line, Req *req) {
+    size_t len = strlen(line);
+    char *method = arena_alloc(a, len + 1);
+    char *uri = arena_alloc(a, len + 1);
+    char *version = arena_alloc(a, len + 1);
+    if (!method || !uri || !version) return -1;
+
+    if (sscanf(line, "%s %s %s", method, uri, version) != 3) return -1;
+    req->purge = !strcasecmp(method, "PURGE");
+    req->range = req->if_range = NULL;
+    if (strcasecmp(method, "GET") && !req->purge) return -1;
 
     // URI parse: host, path, port 
     // 예) url = "http://localhost:8080/index.html"
-    char host[MAXLINE], path[MAXLINE], port[16];
-    parse_uri(uri, host, path, port);
- 
-    char key[MAXLINE];
-    snprintf(key, sizeof(key), "%s:%s%s", host, port, path);
-     
-    char *cached = NULL; 
-    size_t csize = 0;
+    size_t ulen = strlen(uri);
+    req->host = arena_alloc(a, ulen + 1);
+    req->path = arena_alloc(a, ulen + 2);
+    req->port = arena_alloc(a, ulen + 3);   // 기본값 "80"
+    if (!req->host || !req->path || !req->port) return -1;
+    parse_uri(uri, req->host, req->path, req->port);
 
-    if (get_cache(key, &cached, &csize)) {
-        // 캐시 히트시 바로 전송
-        rio_writen(clientfd, cached, csize);
-        free(cached);
+    size_t klen = strlen(req->host) + strlen(req->port) + strlen(req->path) + 2;
+    if (!(req->key = arena_alloc(a, klen))) return -1;
+    snprintf(req->key, klen, "%s:%s%s", req->host, req->port, req->path);
+    return 0;
+}
+
+/* 프록시 자신에게 온 요청에 대한 응답. STATS_PATH 면 캐시 통계 ("이름 값" 한 줄씩), 아니면 404.
+  카운터는 relaxed 로 모은 값이라 서로 정확히 같은 순간의 값은 아님 */
+static char *local_response(Arena *a, const Req *req, size_t *len) {
+    Str body = {0};
+    char line[MAXLINE];
+    const char *status = "200 OK";
+
+    if (!strcmp(req->path, STATS_PATH)) {
+        CacheStats st;
+        cache_stats(&st);
+        unsigned long lookups = st.hits + st.stale + st.misses;
+        int n = snprintf(line, sizeof(line),
+                         "policy %s\nshards %d\ncapacity %zu\nbytes_used %zu\nentries %zu\n"
+                         "hits %lu\nstale %lu\nmisses %lu\nhit_ratio %.4f\n"
+                         "disk_hits %lu\ncoalesced %lu\ninserts %lu\nevictions %lu\nrejected %lu\npurged %lu\n",
+                         cache_policy(), cache_nshards(), st.capacity, st.bytes_used, st.entries,
+                         st.hits, st.stale, st.misses, lookups ? (double)st.hits / lookups : 0.0,
+                         st.disk_hits, st.coalesced, st.inserts, st.evictions, st.rejected, st.purged);
+        if (str_append(a, &body, line, (size_t)n) < 0) return NULL;
+        for (int i = 0; i < CACHE_SIZE_BUCKETS; i++) {
+            if (i < CACHE_SIZE_BUCKETS - 1)
+                n = snprintf(line, sizeof(line), "objects_lt_%zu %zu\n", (size_t)1024 << i, st.size_hist[i]);
+            else
+                n = snprintf(line, sizeof(line), "objects_ge_%zu %zu\n", (size_t)1024 << (i - 1), st.size_hist[i]);
+            if (str_append(a, &body, line, (size_t)n) < 0) return NULL;
+        }
+    } else {
+        status = "404 Not Found";
+        if (str_append(a, &body, "Not found\n", 10) < 0) return NULL;
+    }
+    return text_response(a, status, body.s, body.len, len);
+}
+
+/* PURGE http://host[:port]/path 는 그 key 하나, 끝이 '*' 면 그 앞까지를 prefix 로 모두 뺌.
+  (예: http://host/static/ 뒤에 '*' 를 붙여 보내면 "host:80/static/" 로 시작하는 key 전부)
+  아무나 캐시를 비우지 못하게 loopback 에서 온 요청만 받음 */
+static char *purge_response(Arena *a, int clientfd, const Req *req, size_t *len) {
+    char body[64];
+    size_t n;
+
+    if (!peer_is_local(clientfd))
+        return text_response(a, "403 Forbidden", "PURGE only from localhost\n", 26, len);
+
+    size_t klen = strlen(req->key);
+    if (klen && req->key[klen - 1] == '*') {
+        char *prefix = arena_alloc(a, klen);
+        if (!prefix) return NULL;
+        memcpy(prefix, req->key, klen - 1);
+        prefix[klen - 1] = '\0';
+        n = cache_purge_prefix(prefix);
+    } else {
+        n = (size_t)cache_purge(req->key);
+    }
+    if (!n) return text_response(a, "404 Not Found", "Not cached\n", 11, len);
+    int blen = snprintf(body, sizeof(body), "Purged %zu\n", n);
+    return text_response(a, "200 OK", body, (size_t)blen, len);
+}
+
+static int open_controlfd(const char *path) {
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(sa.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(path);   // 이전 실행이 남긴 소켓 파일
+    if (bind(fd, (SA *)&sa, sizeof(sa)) < 0 || chmod(path, 0600) < 0 || listen(fd, LISTENQ) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 관리용이라 연결은 하나씩 차례로 받음. 한 연결에서 명령 여러 줄 가능
+static void *control_loop(void *arg) {
+    int listenfd = *(int *)arg;
+    char line[MAXLINE], out[MAXLINE];
+    rio_t rio;
+
+    Free(arg);
+    Pthread_detach(pthread_self());
+    for (;;) {
+        int fd = accept(listenfd, NULL, NULL);
+        if (fd < 0) continue;
+        rio_readinitb(&rio, fd);
+        while (rio_readlineb(&rio, line, MAXLINE) > 0) {
+            control_command(line, out, sizeof(out));
+            if (rio_writen(fd, out, strlen(out)) < 0) break;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+static void control_command(char *line, char *out, size_t outlen) {
+    char *save, *verb = strtok_r(line, " \t\r\n", &save);
+    char *what = strtok_r(NULL, " \t\r\n", &save);
+    char *arg = strtok_r(NULL, " \t\r\n", &save);
+    size_t n = 0;
+
+    if (!verb || !what || !arg) {
+        snprintf(out, outlen, "ERR usage: invalidate tag <tag>... | purge key <key> | purge prefix <prefix>\n");
+        return;
+    }
+    if (!strcmp(verb, "invalidate") && !strcmp(what, "tag")) {
+        for (; arg; arg = strtok_r(NULL, " \t\r\n", &save)) n += cache_invalidate_tag(arg);
+    } else if (!strcmp(verb, "purge") && !strcmp(what, "key")) {
+        n = (size_t)cache_purge(arg);
+    } else if (!strcmp(verb, "purge") && !strcmp(what, "prefix")) {
+        n = cache_purge_prefix(arg);
+    } else {
+        snprintf(out, outlen, "ERR unknown command %s %s\n", verb, what);
         return;
     }
+    snprintf(out, outlen, "OK %zu\n", n);
+}
 
-    /* 조건 HTTP/1.0 만 허용 */
-    char server_req[MAXLINE];
-    int n = snprintf(server_req, sizeof(server_req), "GET %s HTTP/1.0\r\n,",path);
-    if (n < 0 || n >= (int)sizeof(server_req)) return;
+static int peer_is_local(int fd) {
+    struct sockaddr_storage ss;
+    socklen_t sl = sizeof(ss);
+    if (getpeername(fd, (SA *)&ss, &sl) < 0) return 0;
+    if (ss.ss_family == AF_INET)
+        return (ntohl(((struct sockaddr_in *)&ss)->sin_addr.s_addr) >> 24) == 127;
+    if (ss.ss_family == AF_INET6) {
+        struct in6_addr *a6 = &((struct sockaddr_in6 *)&ss)->sin6_addr;
+        return IN6_IS_ADDR_LOOPBACK(a6) ||
+               (IN6_IS_ADDR_V4MAPPED(a6) && a6->s6_addr[12] == 127);
+    }
+    return 0;
+}
 
-    // 나머지 headers 담기 
-    char hdrs[MAXLINE*8];
-    int has_host = 0;
-    //host 찾기 
-    request_headers(&rio_client, host, hdrs, sizeof(hdrs), &has_host);
+// 프록시가 직접 만드는 짧은 text/plain 응답
+static char *text_response(Arena *a, const char *status, const char *body, size_t blen, size_t *len) {
+    char hdr[256];
+    int hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.0 %s\r\nContent-Type: text/plain\r\n"
+                        "Cache-Control: no-store\r\nContent-Length: %zu\r\n\r\n", status, blen);
+    char *resp = arena_alloc(a, (size_t)hlen + blen);
+    if (!resp) return NULL;
+    memcpy(resp, hdr, (size_t)hlen);
+    memcpy(resp + hlen, body, blen);
+    *len = (size_t)hlen + blen;
+    return resp;
+}
 
-    // HTTP 1.0은 Host가 없을 수 있음
-    // 클라이언트가 Host 헤더를 안 보냈다면,Host 헤더를 만들어 줘야함
-    char host_line[MAXLINE] = {0};
-    if (!has_host) {
-        snprintf(host_line, sizeof(host_line), "Host: %s\r\n", host);
-    }
-
-    char request_f[MAXLINE * 12];
-    int written = snprintf(request_f, sizeof(request_f),
-        "GET %s HTTP/1.0\r\n"
-        "%s"  // Host (없으면 빈 문자열) 
-        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 Firefox/10.0.3\r\n"
-        "Connection: close\r\n"
-        "Proxy-Connection: close\r\n"
-        "%s"  // 기타 header
-        "\r\n", 
-        path,
-        host_line,
-        hdrs
-    );
-    if (written < 0 || written >= (int)sizeof(request_f)) return;
-
-    int serverfd = Open_clientfd(host, port);
-    if (serverfd < 0) return;
-
-    Rio_writen(serverfd, request_f, strlen(request_f));
-
-    rio_t rio_server;
-    Rio_readinitb(&rio_server, serverfd);
-    ssize_t cnt;
-
-    size_t total = 0;
-    int cacheable = 1;
-    char *resp_buf = malloc(MAX_OBJECT_SIZE);
-    if (!resp_buf) cacheable = 0;
-
-    while ((cnt = Rio_readnb(&rio_server, buf, sizeof(buf))) > 0) {
-
-      Rio_writen(clientfd, buf, cnt);
-
-      //캐시 버퍼에 누적 (MAX_OBJECT_SIZE 넘으면 캐시 포기)
-      if (cacheable) {
-        if (total + (size_t)cnt <= MAX_OBJECT_SIZE) {
-            memcpy(resp_buf + total, buf, (size_t)cnt);
-            total += (size_t)cnt;
-        } else {
-            cacheable = 0;
+static int header_is(const char *line, size_t len, const char *name) {
+    size_t n = strlen(name);
+    return len > n && line[n] == ':' && !strncasecmp(line, name, n);
+}
+
+/* 저장된 전체 응답 obj 에서 req->range 구간만 골라 206 (여러 구간이면 multipart/byteranges),
+  하나도 본문 안에 없으면 416. head 는 arena 에 만들고, 구간 하나면 body 는 obj 안을 가리킴 (아니면 NULL).
+  적용할 수 없으면 -1 -> 호출자가 전체 응답: 200 이 아님, If-Range 가 다른 버전, Range 형식 오류,
+  겹치는 구간들로 객체보다 커지는 요청 */
+static int range_response(Arena *a, const Req *req, const CacheObj *obj,
+                          char **head, size_t *hlen, const char **body, size_t *blen) {
+    HttpMeta m;
+    HttpRange r[RANGE_MAX];
+    size_t hend = http_header_end(obj->data, obj->size);
+    if (!hend || http_parse_response(obj->data, hend, &m) < 0 || m.status != 200) return -1;
+
+    // If-Range: 클라이언트가 가진 버전과 같을 때만 일부를 줌 (강한 ETag 또는 Last-Modified 문자열 그대로)
+    if (req->if_range) {
+        size_t n = strlen(req->if_range);
+        int is_etag = req->if_range[0] == '"';
+        const char *v = is_etag ? m.etag : req->if_range[0] == 'W' ? NULL : m.lastmod;
+        size_t vlen = is_etag ? m.etag_len : m.lastmod_len;
+        if (!v || vlen != n || memcmp(v, req->if_range, n)) return -1;
+    }
+
+    const char *data = obj->data + hend;
+    size_t total = obj->size - hend;
+    int n = http_parse_range(req->range, strlen(req->range), total, r, RANGE_MAX);
+    if (n < 0) return -1;
+
+    Str h = {0};
+    char line[MAXLINE];
+    int len;
+    *body = NULL;
+    *blen = 0;
+    if (n == 0) {
+        len = snprintf(line, sizeof(line), "HTTP/1.0 416 Range Not Satisfiable\r\n"
+                       "Content-Range: bytes */%zu\r\nContent-Length: 0\r\n\r\n", total);
+        if (str_append(a, &h, line, (size_t)len) < 0) return -1;
+        *head = h.s;
+        *hlen = h.len;
+        return 0;
+    }
+    size_t sum = 0;
+    for (int i = 0; i < n; i++) sum += r[i].last - r[i].first + 1;
+    if (sum > total) return -1;
+
+    // 원래 헤더에서 길이/형식 관련만 바꿔 씀 (상태 줄 다음부터 마지막 빈 줄 전까지).
+    // 빈 줄은 "\r\n" 또는 "\n" (http_header_end)
+    const char *hdr_end = obj->data + hend - (obj->data[hend - 2] == '\r' ? 2 : 1);
+    const char *ctype = NULL;
+    size_t ctlen = 0;
+    static const char status[] = "HTTP/1.0 206 Partial Content\r\n";
+    if (str_append(a, &h, status, sizeof(status) - 1) < 0) return -1;
+    for (const char *p = memchr(obj->data, '\n', hend) + 1; p < hdr_end; ) {
+        const char *nl = memchr(p, '\n', (size_t)(hdr_end - p));
+        size_t ll = nl ? (size_t)(nl - p) + 1 : (size_t)(hdr_end - p);
+        if (header_is(p, ll, "Content-Type")) {
+            // 여러 구간이면 각 part 로 옮김
+            ctype = p + 13;
+            ctlen = ll - 13;
+            while (ctlen && (*ctype == ' ' || *ctype == '\t')) ctype++, ctlen--;
+            while (ctlen && (ctype[ctlen - 1] == '\r' || ctype[ctlen - 1] == '\n')) ctlen--;
+            if (n == 1 && str_append(a, &h, p, ll) < 0) return -1;
+        } else if (!header_is(p, ll, "Content-Length") && !header_is(p, ll, "Content-Range") &&
+                   !header_is(p, ll, "Accept-Ranges")) {
+            if (str_append(a, &h, p, ll) < 0) return -1;
         }
-      } 
+        p += ll;
     }
-    if (cacheable) {
-        // 헤더+바디 전체 넣기 
-        put_cache(key, resp_buf, total);
+
+    if (n == 1) {
+        len = snprintf(line, sizeof(line), "Accept-Ranges: bytes\r\nContent-Range: bytes %zu-%zu/%zu\r\n"
+                       "Content-Length: %zu\r\n\r\n", r[0].first, r[0].last, total, sum);
+        if (str_append(a, &h, line, (size_t)len) < 0) return -1;
+        *body = data + r[0].first;
+        *blen = sum;
+    } else {
+        // 구간들을 part 로 이어 붙인 본문을 헤더 뒤에 (합이 객체 크기 이하)
+        char boundary[40];
+        Str parts = {0};
+        snprintf(boundary, sizeof(boundary), "proxy-%08lx%08lx", random(), random());
+        for (int i = 0; i < n; i++) {
+            len = snprintf(line, sizeof(line), "\r\n--%s\r\n%s%.*s%sContent-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                           boundary, ctype ? "Content-Type: " : "", (int)ctlen, ctype ? ctype : "",
+                           ctype ? "\r\n" : "", r[i].first, r[i].last, total);
+            if (len < 0 || (size_t)len >= sizeof(line) ||
+                str_append(a, &parts, line, (size_t)len) < 0 ||
+                str_append(a, &parts, data + r[i].first, r[i].last - r[i].first + 1) < 0)
+                return -1;
+        }
+        len = snprintf(line, sizeof(line), "\r\n--%s--\r\n", boundary);
+        if (str_append(a, &parts, line, (size_t)len) < 0) return -1;
+        len = snprintf(line, sizeof(line), "Accept-Ranges: bytes\r\nContent-Type: multipart/byteranges; "
+                       "boundary=%s\r\nContent-Length: %zu\r\n\r\n", boundary, parts.len);
+        if (str_append(a, &h, line, (size_t)len) < 0 || str_append(a, &h, parts.s, parts.len) < 0) return -1;
     }
-    free(resp_buf);
+    *head = h.s;
+    *hlen = h.len;
+    return 0;
+}
 
-    Close(serverfd);
+// 캐시된 응답을 보냄. Range 요청이면 잘라서
+static void send_cached(int clientfd, Arena *a, const Req *req, CacheObj *obj) {
+    char *head;
+    const char *body;
+    size_t hlen, blen;
+    if (req->range && range_response(a, req, obj, &head, &hlen, &body, &blen) == 0) {
+        if (rio_writen(clientfd, head, hlen) >= 0 && body) rio_writen(clientfd, (void *)body, blen);
+        return;
+    }
+    rio_writen(clientfd, obj->data, obj->size);
+}
+
+/* 캐시에서 바로 답할 수 없는 Range 요청: 전체 객체를 한 번만 받아 캐시를 채우고 거기서 잘라 줌.
+  리더 몫은 stale 과 함께 재검증 스레드에 넘겨 전체를 받게 하고, 이 요청은 따라온 요청처럼
+  f 가 끝나기를 기다림 (0, f 를 따라 읽을 것). flight 가 없으면 -1 -> Range 를 붙여 직접 */
+static int range_follow(const Req *req, int role, Flight *f, CacheObj *stale) {
+    if (!f) {
+        cache_release(stale);
+        return -1;
+    }
+    if (role == FLIGHT_LEAD) {
+        flight_hold(f);
+        refresh_submit(req, f, stale);
+    } else {
+        cache_release(stale);
+    }
+    return 0;
+}
+
+// f 가 채운 전체 객체. 실패했거나 저장되지 않았으면 NULL
+static CacheObj *range_filled(const Req *req) {
+    CacheObj *obj = get_cache(req->key);
+    if (obj && atomic_load_explicit(&obj->expires, memory_order_relaxed) <= time(NULL)) {
+        cache_release(obj);   // 새로 못 넣고 남은 만료된 객체
+        obj = NULL;
+    }
+    return obj;
+}
+
+// range_follow 다음: 전체가 캐시에 들어오면 잘라 보냄. 못 들어갔으면 -1 (아직 아무것도 안 보냄)
+static int range_wait(int clientfd, Arena *a, const Req *req, Flight *f) {
+    size_t off = 0;
+    const char *p;
+    long n;
+    while ((n = flight_read(f, off, &p, NULL)) > 0) off += (size_t)n;
+    flight_leave(f);
+
+    CacheObj *obj = n == 0 ? range_filled(req) : NULL;
+    if (!obj) return -1;
+    send_cached(clientfd, a, req, obj);
+    cache_release(obj);
+    return 0;
+}
+
+// origin 에 그대로 넘길 Range / If-Range (206 은 저장 안 함)
+static void range_headers(Arena *a, const Req *req, Str *hdrs) {
+    str_append(a, hdrs, "Range: ", 7);
+    str_append(a, hdrs, req->range, strlen(req->range));
+    str_append(a, hdrs, "\r\n", 2);
+    if (req->if_range) {
+        str_append(a, hdrs, "If-Range: ", 10);
+        str_append(a, hdrs, req->if_range, strlen(req->if_range));
+        str_append(a, hdrs, "\r\n", 2);
+    }
 }
 
 /* 절대 uri 처리 
@@ -208,156 +1359,855 @@ static void parse_uri(const char *uri, char *host, char *path, char *port) {
     }
 }
 
-static void request_headers(rio_t *client_rio, char *host, char *hdr_buf, size_t hdr_bufsz, int *has_host) {
+// line 은 MAXLINE 짜리 줄 버퍼 (호출자 것을 재사용)
+static void request_headers(rio_t *client_rio, char *line, Arena *a, Req *req, Str *hdrs, int *has_host) {
     *has_host = 0;
-    hdr_buf[0] = '\0';
 
-    char line[MAXLINE];
     while (1) {
-        if (Rio_readlineb(client_rio, line, sizeof(line)) <= 0) break;
+        if (Rio_readlineb(client_rio, line, MAXLINE) <= 0) break;
         if (!strcmp(line, "\r\n")) break; // 헤더 끝
 
-        char key[MAXLINE]; int i = 0;
-        while (line[i] && line[i] != ':' && i < (int)sizeof(key)-1) {
-            key[i] = line[i];
-            i++;
-        }
-        key[i] = '\0';
-        for (int j = 0; key[j]; ++j) key[j] = tolower((unsigned char)key[j]);
+        filter_header(a, req, hdrs, line, strlen(line), has_host);
+    }
+}
 
-        if (!strncmp(key, "host", 4)) {
-            *has_host = 1;
-            continue;
-        }
-        if (!strncmp(key, "user-agent", 10)) continue;
-        if (!strncmp(key, "connection", 10)) continue;
-        if (!strncmp(key, "proxy-connection", 16)) continue;
-
-        size_t cur = strlen(hdr_buf);
-        size_t left = hdr_bufsz - cur - 1;
-        if (left > 0) {
-            strncat(hdr_buf, line, left);
+// 헤더 값 (앞 공백, 끝 CRLF 뺌) 을 arena 문자열로
+static char *header_copy(Arena *a, const char *line, size_t len, size_t name_len) {
+    const char *v = line + name_len, *end = line + len;
+    while (v < end && (*v == ' ' || *v == '\t')) v++;
+    while (end > v && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) end--;
+    return arena_strndup(a, v, (size_t)(end - v));
+}
+
+// 헤더 한 줄을 검사해서 프록시가 직접 채우는 헤더가 아니면 hdrs 뒤에 붙임
+static void filter_header(Arena *a, Req *req, Str *hdrs, const char *line, size_t len, int *has_host) {
+    if (!strncasecmp(line, "host", 4)) {
+        *has_host = 1;
+        return;
+    }
+    if (!strncasecmp(line, "user-agent", 10)) return;
+    if (!strncasecmp(line, "connection", 10)) return;
+    if (!strncasecmp(line, "proxy-connection", 16)) return;
+    // 클라이언트 조건부 헤더는 빼고 항상 전체 응답을 받음 (304 를 캐시에 넣지 않도록.
+    // 재검증은 프록시가 저장된 응답 기준으로 따로 붙임)
+    if (!strncasecmp(line, "if-none-match", 13)) return;
+    if (!strncasecmp(line, "if-modified-since", 17)) return;
+    // Range 는 캐시에 있는 전체 객체에서 프록시가 잘라 줌
+    if (!strncasecmp(line, "range:", 6)) {
+        req->range = header_copy(a, line, len, 6);
+        return;
+    }
+    if (!strncasecmp(line, "if-range:", 9)) {
+        req->if_range = header_copy(a, line, len, 9);
+        return;
+    }
+
+    if (hdrs->len + len < HDRS_MAX) {
+        str_append(a, hdrs, line, len);
+    }
+}
+
+#define REQUEST_FMT \
+    "GET %s HTTP/1.0\r\n" \
+    "%s"  /* Host (없으면 빈 문자열) */ \
+    "%s"  /* User-Agent */ \
+    "Connection: close\r\n" \
+    "Proxy-Connection: close\r\n" \
+    "%s"  /* 기타 header */ \
+    "\r\n"
+
+// 서버로 보낼 HTTP/1.0 요청을 필요한 크기만큼 arena 에 조립. 실패 시 NULL
+static char *build_request(Arena *a, const char *path, const char *host,
+                           const char *hdrs, int has_host, int *outlen) {
+    // HTTP 1.0은 Host가 없을 수 있음
+    // 클라이언트가 Host 헤더를 안 보냈다면,Host 헤더를 만들어 줘야함
+    const char *host_line = "";
+    if (!has_host) {
+        size_t hlen = strlen(host) + sizeof("Host: \r\n");
+        char *p = arena_alloc(a, hlen);
+        if (!p) return NULL;
+        snprintf(p, hlen, "Host: %s\r\n", host);
+        host_line = p;
+    }
+
+    int n = snprintf(NULL, 0, REQUEST_FMT, path, host_line, user_agent_hdr, hdrs);
+    if (n < 0) return NULL;
+    char *out = arena_alloc(a, (size_t)n + 1);
+    if (!out) return NULL;
+    snprintf(out, (size_t)n + 1, REQUEST_FMT, path, host_line, user_agent_hdr, hdrs);
+    *outlen = n;
+    return out;
+}
+
+/* epoll 이벤트 루프 (-e)
+  연결마다 스레드를 두지 않고, 연결 상태 머신을 non-blocking으로 진행
+  요청 파싱 -> 캐시 조회 -> 서버 연결/요청 -> relay 순서는 doit_proxy와 같음 */
+typedef enum {
+    C_READ_REQ,     // 클라이언트 요청 헤더 수신 중
+    C_RESOLVING,    // 서버 주소를 조회 스레드가 찾는 중 (끝나면 mail 로 깨어남)
+    C_CONNECTING,   // 서버 non-blocking connect 완료 대기
+    C_SEND_REQ,     // 서버로 요청 전송 중
+    C_RESP_HDR,     // 서버 응답 헤더 수신 중 (캐시 판단 / 304 처리)
+    C_RELAY,        // 서버 응답 -> 클라이언트 중계
+    C_SEND_HIT,     // 캐시 히트 응답 전송 중
+    C_FOLLOW        // 같은 key 를 가져오는 다른 연결의 flight 를 따라 읽는 중
+} ConnState;
+
+typedef enum { H_CLI, H_SRV, H_WAKE } HandleKind;
+
+// origin 하나의 주소들 (getaddrinfo 결과 사본)
+typedef struct {
+    int n;
+    struct {
+        int family, socktype, protocol;
+        socklen_t len;
+        struct sockaddr_storage sa;
+    } a[DNS_MAX_ADDRS];
+} DnsAddrs;
+
+struct Conn;
+typedef struct {
+    struct Conn *conn;
+    HandleKind kind;
+} Handle;           // epoll data.ptr 로 어느 쪽 fd 이벤트인지 구분
+
+// 루프마다 하나. 다른 스레드의 리더가 새 바이트를 받거나 조회 스레드가 주소를 찾으면
+// mail 에 연결을 넣고 wakefd 로 깨움
+typedef struct {
+    int epfd;
+    int wakefd;                 // eventfd
+    Handle h_wake;
+    pthread_mutex_t mu;         // mail 보호
+    struct Conn *mail;
+    struct Conn *closing;       // 이번 epoll_wait 묶음이 끝나면 해제할 연결 (루프 스레드만)
+} Loop;
+
+typedef struct Conn {
+    Loop *loop;
+    int clientfd, serverfd;
+    ConnState st;
+    Handle h_cli, h_srv;
+
+    Arena arena;                           // 요청/키/relay 버퍼
+    char *in;  size_t in_len, in_cap;      // 요청 헤더 누적
+    char *out; size_t out_len, out_off;    // 보낼 데이터 (요청 / 히트 응답 / relay 조각)
+    const char *tail; size_t tail_len;     // 히트 응답에서 out 다음에 보낼 것 (범위 응답 본문, hit 객체 안)
+    CacheObj *hit;                         // 캐시 히트 객체 (참조 잡은 상태)
+    CacheObj *stale;                       // 만료 객체 (재검증 대상, 서버 실패 시 대신 보냄)
+    int revalidating;                      // stale 의 검증자로 조건부 요청을 보냄
+    char *io;                              // relay 읽기 버퍼 (MAXLINE)
+
+    char *key;
+    RespBuf resp;                          // 캐시용 응답 누적
+
+    Req req;                               // 따라 읽다가 직접 가져와야 할 때 필요
+    char *reqbuf; size_t reqlen;           // 서버로 보낼 요청
+    char *origin;                          // "host:port" (주소 캐시 key)
+    DnsAddrs *addrs;                       // 조회 스레드가 채움 (C_RESOLVING)
+    Flight *flight;                        // 리더면 채우는 flight, 아니면 따라 읽는 flight
+    int leader;
+    size_t follow_off;                     // flight 에서 다음에 읽을 위치
+    int range_wait;                        // Range 요청: 따라 읽은 바이트는 버리고 끝나면 캐시에서 잘라 보냄
+    int armed;                             // waiter 가 flight 에 걸렸거나 조회 중 (깨어날 때까지 해제 금지)
+    int dead;                              // 끊김/정리됨: 남은 이벤트는 무시 (armed 면 깨어날 때 정리)
+    int closing;                           // loop->closing 에 들어 있음
+    FlightWaiter waiter;
+    struct Conn *mail_next;
+    struct Conn *close_next;
+    struct Conn *resolve_next;             // 조회 대기열
+} Conn;
+
+#define CONN_ARENA_BLOCK 4096
+
+#define REQ_MAX (MAXLINE * 12)   // 요청 헤더 최대 크기
+
+static int set_nonblock(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+    if (fl < 0) return -1;
+    return fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+static void ep_set(Conn *c, Handle *h, int fd, uint32_t events, int op) {
+    struct epoll_event ev = { .events = events, .data.ptr = h };
+    epoll_ctl(c->loop->epfd, op, fd, &ev);
+}
+
+/* 연결 정리는 묶음 끝으로 미룸: 같은 epoll_wait 묶음에 이 연결의 다른 Handle 이벤트가
+  남아 있을 수 있는데 (Handle 이 Conn 안에 있음), 그걸 읽기 전에 해제하면 안 됨 */
+static void conn_close(Conn *c) {
+    c->dead = 1;
+    if (c->closing) return;
+    c->closing = 1;
+    c->close_next = c->loop->closing;
+    c->loop->closing = c;
+}
+
+static void conn_free(Conn *c) {
+    // 리더가 중간에 실패하면 따라온 요청들에게 알림 (리더의 flight 는 resp.flight)
+    if (c->leader) resp_finish(&c->resp, c->key, 0);
+    else if (c->flight) flight_leave(c->flight);
+    // close 하면 epoll 등록도 같이 빠짐
+    if (c->serverfd >= 0) close(c->serverfd);
+    close(c->clientfd);
+    free(c->in);
+    cache_release(c->hit);
+    cache_release(c->stale);
+    free(c->resp.data);
+    arena_free(&c->arena);
+    free(c);
+}
+
+// 가능한 만큼 out 을 fd 로 보냄. 다 보내면 1, 막히면 0, 에러 -1
+static int conn_flush(Conn *c, int fd) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = write(fd, c->out + c->out_off, c->out_len - c->out_off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
         }
+        c->out_off += (size_t)n;
     }
+    return 1;
 }
-/* Utility*/
-static Entry* find_entry(const char *key) {
-    for (Entry *ent = g_cache.head; ent; ent = ent->next)
-        if (strcmp(ent->key, key) == 0) return ent;
+
+/* 서버 주소 조회. getaddrinfo 는 blocking 이라 이벤트 루프에서 부르면 그동안 루프의 모든 연결이 멈춤:
+  조회는 전용 스레드에서 하고 결과는 mail 로 연결의 루프에 돌려줌.
+  찾은 주소는 origin ("host:port") 별로 DNS_TTL 동안 기억해서 다음 미스는 루프 안에서 바로 connect */
+static struct {
+    pthread_mutex_t mu;
+    struct {
+        char *key;        // NULL 이면 빈 칸
+        time_t expires;
+        DnsAddrs addrs;
+    } slot[DNS_SLOTS];
+} g_dns = { .mu = PTHREAD_MUTEX_INITIALIZER };
+
+static struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cond;
+    Conn *head, *tail;
+} g_resolve = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+static pthread_once_t g_resolve_once = PTHREAD_ONCE_INIT;
+
+static void conn_wake(FlightWaiter *w);
+
+static unsigned dns_slot(const char *key) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    while (*key) h = (h ^ (unsigned char)*key++) * 16777619u;
+    return h % DNS_SLOTS;
+}
+
+// 기억해 둔 주소가 아직 쓸 만하면 out 에 복사하고 1
+static int dns_cached(const char *key, DnsAddrs *out) {
+    unsigned i = dns_slot(key);
+    int found = 0;
+    pthread_mutex_lock(&g_dns.mu);
+    if (g_dns.slot[i].key && !strcmp(g_dns.slot[i].key, key) && g_dns.slot[i].expires > time(NULL)) {
+        *out = g_dns.slot[i].addrs;
+        found = 1;
+    }
+    pthread_mutex_unlock(&g_dns.mu);
+    return found;
+}
+
+static void dns_remember(const char *key, const DnsAddrs *addrs) {
+    unsigned i = dns_slot(key);
+    char *k = strdup(key);
+    if (!k) return;
+    pthread_mutex_lock(&g_dns.mu);
+    free(g_dns.slot[i].key);
+    g_dns.slot[i].key = k;
+    g_dns.slot[i].expires = time(NULL) + DNS_TTL;
+    g_dns.slot[i].addrs = *addrs;
+    pthread_mutex_unlock(&g_dns.mu);
+}
+
+// blocking 조회. 찾은 주소 수 (못 찾으면 0)
+static int dns_resolve(const char *host, const char *port, DnsAddrs *out) {
+    struct addrinfo hints, *listp, *p;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    out->n = 0;
+    if (getaddrinfo(host, port, &hints, &listp) != 0) return 0;
+    for (p = listp; p && out->n < DNS_MAX_ADDRS; p = p->ai_next) {
+        if (p->ai_addrlen > sizeof(out->a[0].sa)) continue;
+        out->a[out->n].family = p->ai_family;
+        out->a[out->n].socktype = p->ai_socktype;
+        out->a[out->n].protocol = p->ai_protocol;
+        out->a[out->n].len = p->ai_addrlen;
+        memcpy(&out->a[out->n].sa, p->ai_addr, p->ai_addrlen);
+        out->n++;
+    }
+    freeaddrinfo(listp);
+    return out->n;
+}
+
+static void *resolve_worker(void *arg) {
+    (void)arg;
+    pthread_detach(pthread_self());
+    while (1) {
+        pthread_mutex_lock(&g_resolve.mu);
+        while (!g_resolve.head) pthread_cond_wait(&g_resolve.cond, &g_resolve.mu);
+        Conn *c = g_resolve.head;
+        if (!(g_resolve.head = c->resolve_next)) g_resolve.tail = NULL;
+        pthread_mutex_unlock(&g_resolve.mu);
+
+        // 연결은 깨어날 때까지 해제되지 않음 (armed). 끊겼어도 조회는 끝내고 캐시에 남김
+        if (dns_resolve(c->req.host, c->req.port, c->addrs)) dns_remember(c->origin, c->addrs);
+        conn_wake(&c->waiter);
+    }
     return NULL;
 }
 
-// 첫 삽입 
-static void insert_first(Entry *ent) {
-    ent->prev = NULL;
-    ent->next = g_cache.head;
-    if (g_cache.head) g_cache.head->prev = ent;
-    g_cache.head = ent;
-    if (!g_cache.tail) g_cache.tail = ent;
+static void resolve_start(void) {
+    for (int i = 0; i < RESOLVE_WORKERS; i++) {
+        pthread_t tid;
+        Pthread_create(&tid, &g_thread_attr, resolve_worker, NULL);
+    }
+}
+
+static void resolve_submit(Conn *c) {
+    pthread_once(&g_resolve_once, resolve_start);
+    c->resolve_next = NULL;
+    pthread_mutex_lock(&g_resolve.mu);
+    if (g_resolve.tail) g_resolve.tail->resolve_next = c;
+    else g_resolve.head = c;
+    g_resolve.tail = c;
+    pthread_cond_signal(&g_resolve.cond);
+    pthread_mutex_unlock(&g_resolve.mu);
 }
 
-// 재연결 후 삭제
-static void list_remove_nolock(Entry *ent) {
-    if (ent->prev) ent->prev->next = ent->next; 
-    else g_cache.head = ent->next;
-    
-    if (ent->next) ent->next->prev = ent->prev; 
-    else g_cache.tail = ent->prev;
+// 조회한 주소들로 차례로 non-blocking connect 시작
+static int connect_nonblock(const DnsAddrs *addrs) {
+    for (int i = 0; i < addrs->n; i++) {
+        int fd = socket(addrs->a[i].family, addrs->a[i].socktype | SOCK_NONBLOCK, addrs->a[i].protocol);
+        if (fd < 0) continue;
+        if (connect(fd, (const struct sockaddr *)&addrs->a[i].sa, addrs->a[i].len) == 0 ||
+            errno == EINPROGRESS)
+            return fd;
+        close(fd);
+    }
+    return -1;
+}
 
-    ent->prev = ent->next = NULL;
+// 준비된 응답 하나를 보내고 끝냄 (캐시 히트, 502 등)
+static void conn_send(Conn *c, char *data, size_t len) {
+    c->out = data;
+    c->out_len = len;
+    c->out_off = 0;
+    c->st = C_SEND_HIT;
+    ep_set(c, &c->h_cli, c->clientfd, EPOLLOUT, EPOLL_CTL_MOD);
 }
 
-static void free_entry(Entry *ent) {
-    free(ent->key);
-    free(ent->data);
-    free(ent);
+static void conn_serve_hit(Conn *c, CacheObj *obj) {
+    char *head;
+    size_t hlen;
+    c->hit = obj;
+    if (c->req.range && range_response(&c->arena, &c->req, obj, &head, &hlen, &c->tail, &c->tail_len) == 0)
+        conn_send(c, head, hlen);
+    else
+        conn_send(c, obj->data, obj->size);
 }
 
-// last_use가 가장 오래된 엔트리 선택 
-static Entry* find_oldest(void) {
-    Entry *cur = g_cache.head, *victim = NULL;
-    unsigned long best = (unsigned long)-1;
-    while (cur) {
-        unsigned long lu = atomic_load_explicit(&cur->last_use, memory_order_relaxed);
-        if (lu < best) { best = lu; victim = cur; }
-        cur = cur->next;
+// 히트 응답 (out 다음 tail) 을 보냄. 다 보내면 1, 막히면 0, 에러 -1
+static int conn_flush_hit(Conn *c) {
+    int r;
+    while ((r = conn_flush(c, c->clientfd)) == 1 && c->tail) {
+        c->out = (char *)c->tail;
+        c->out_len = c->tail_len;
+        c->out_off = 0;
+        c->tail = NULL;
     }
-    return victim;
+    return r;
 }
 
-int get_cache(const char *key, char **out, size_t *out_sz) {
-    int hit = 0;
-    char *copy = NULL;
-    size_t n = 0;
+/* 클라이언트에 아무것도 보내기 전에 서버가 실패함: stale-if-error 창 안이면 저장된 응답을 히트처럼 보냄.
+  origin 에 닿지도 못했으면 (unreachable) 502, 그 외엔 -1 (연결 정리) */
+static int conn_origin_error(Conn *c, int unreachable) {
+    if (c->stale && stale_usable(c->stale, 1)) {
+        if (c->serverfd >= 0) close(c->serverfd);
+        c->serverfd = -1;
+        if (c->resp.flight) flight_append(c->resp.flight, c->stale->data, c->stale->size);
+        c->resp.cacheable = 0;
+        resp_finish(&c->resp, c->key, 1);
+        conn_serve_hit(c, c->stale);
+        c->stale = NULL;
+        return 0;
+    }
+
+    size_t len;
+    char *resp;
+    if (!unreachable || !(resp = bad_gateway(&c->arena, &c->req, &len))) return -1;
+    if (c->serverfd >= 0) close(c->serverfd);
+    c->serverfd = -1;
+    resp_finish(&c->resp, c->key, 0);   // 따라온 요청들은 각자 가져오다 negative 엔트리를 만남
+    conn_send(c, resp, len);
+    return 0;
+}
 
-    pthread_rwlock_rdlock(&g_cache.rw);               
-    Entry *ent = find_entry(key);
-    if (ent) {
-        // 복사본 생성 락 안에서 짧게 복사 (use-after-free 방지)
-        copy = (char *)malloc(ent->size);
-        if (copy) {
-            memcpy(copy, ent->data, ent->size);
-            n = ent->size;
-            hit = 1;
-
-            // 최근 접근 틱만 원자적으로 갱신 (리스트 이동 없음)
-            unsigned long t = atomic_fetch_add_explicit(&g_ticks, 1, memory_order_relaxed);
-            atomic_store_explicit(&ent->last_use, t, memory_order_relaxed);
+// 주소를 알았으니 connect (조회 실패면 addrs->n == 0)
+static int conn_connect_addrs(Conn *c) {
+    if ((c->serverfd = connect_nonblock(c->addrs)) < 0) {
+        origin_mark_down(&c->arena, &c->req);
+        return conn_origin_error(c, 1);
+    }
+    c->st = C_CONNECTING;
+    ep_set(c, &c->h_cli, c->clientfd, 0, EPOLL_CTL_MOD);
+    ep_set(c, &c->h_srv, c->serverfd, EPOLLOUT, EPOLL_CTL_ADD);
+    return 0;
+}
+
+// 서버 연결 시작. 주소를 기억해 두지 않았으면 조회 스레드로 넘기고 깨어날 때까지 기다림
+static int conn_connect(Conn *c) {
+    c->out = c->reqbuf;
+    c->out_len = c->reqlen;
+    c->out_off = 0;
+    c->resp.cacheable = 1;
+    c->resp.epoch = cache_epoch(c->req.key);
+    // 방금 연결 실패한 origin 이면 DNS/connect 를 반복하지 않음
+    if (origin_down(&c->arena, &c->req)) return conn_origin_error(c, 1);
+    if (!c->addrs && !(c->addrs = arena_alloc(&c->arena, sizeof(DnsAddrs)))) return -1;
+    if (!c->origin && !(c->origin = origin_key(&c->arena, &c->req))) return -1;
+    if (dns_cached(c->origin, c->addrs)) return conn_connect_addrs(c);
+
+    c->st = C_RESOLVING;
+    c->armed = 1;
+    ep_set(c, &c->h_cli, c->clientfd, 0, EPOLL_CTL_MOD);   // HUP/ERR 만
+    resolve_submit(c);
+    return 0;
+}
+
+// range_follow 다음: 전체가 캐시에 들어오면 잘라 보냄. 못 들어갔으면 Range 를 붙인 요청으로 직접
+static int conn_range_wait(Conn *c) {
+    const char *p;
+    long n;
+    while ((n = flight_read(c->flight, c->follow_off, &p, &c->waiter)) > 0)
+        c->follow_off += (size_t)n;
+    if (n == FLIGHT_AGAIN) {
+        c->armed = 1;
+        ep_set(c, &c->h_cli, c->clientfd, 0, EPOLL_CTL_MOD);
+        return 0;
+    }
+    flight_leave(c->flight);
+    c->flight = NULL;
+    c->range_wait = 0;
+
+    CacheObj *obj = n == 0 ? range_filled(&c->req) : NULL;
+    if (!obj) return conn_connect(c);
+    conn_serve_hit(c, obj);
+    return 0;
+}
+
+/* 따라온 연결: flight 에 채워진 만큼 클라이언트로 보냄.
+  클라이언트가 막히면 EPOLLOUT, 새 바이트가 없으면 waiter 를 걸고 wake 를 기다림.
+  끝까지 보냈거나 에러면 -1 (연결 정리) */
+static int conn_follow(Conn *c) {
+    if (c->range_wait) return conn_range_wait(c);
+    while (1) {
+        int r = conn_flush(c, c->clientfd);
+        if (r < 0) return -1;
+        if (r == 0) {
+            ep_set(c, &c->h_cli, c->clientfd, EPOLLOUT, EPOLL_CTL_MOD);
+            return 0;
+        }
+
+        const char *p;
+        long n = flight_read(c->flight, c->follow_off, &p, &c->waiter);
+        if (n == FLIGHT_AGAIN) {
+            // 이벤트 없이 둠 (HUP/ERR 만 옴)
+            c->armed = 1;
+            ep_set(c, &c->h_cli, c->clientfd, 0, EPOLL_CTL_MOD);
+            return 0;
+        }
+        if (n == FLIGHT_ERR && c->follow_off == 0) {
+            // 보낸 게 없는데 리더가 실패했거나 상한을 넘은 응답: 직접 가져옴
+            flight_leave(c->flight);
+            c->flight = NULL;
+            return conn_connect(c);
         }
+        if (n <= 0) return -1;
+
+        c->out = (char *)p;
+        c->out_len = (size_t)n;
+        c->out_off = 0;
+        c->follow_off += (size_t)n;
     }
-    pthread_rwlock_unlock(&g_cache.rw);
+}
 
-    if (!hit) return 0;
-    *out = copy;
-    *out_sz = n;
-    return 1;
+// 요청 헤더가 다 모이면 호출: 파싱 후 캐시 히트면 바로 응답, 아니면 서버 연결
+static int conn_start(Conn *c) {
+    char *eol = strstr(c->in, "\r\n");
+    *eol = '\0';
+
+    if (parse_request(&c->arena, c->in, &c->req) < 0) return -1;
+    if (!c->req.host[0] || c->req.purge) {
+        size_t len;
+        char *resp = c->req.host[0] ? purge_response(&c->arena, c->clientfd, &c->req, &len)
+                                    : local_response(&c->arena, &c->req, &len);
+        if (!resp) return -1;
+        conn_send(c, resp, len);
+        return 0;
+    }
+
+    // 나머지 header 한 줄씩 걸러 담기 (Range 는 히트에서도 봐야 하고, 따라 읽다가 직접 가져올 수도 있음)
+    Str hdrs = {0};
+    int has_host = 0;
+    for (char *line = eol + 2; strncmp(line, "\r\n", 2); ) {
+        char *next = strstr(line, "\r\n") + 2;
+        filter_header(&c->arena, &c->req, &hdrs, line, (size_t)(next - line), &has_host);
+        line = next;
+    }
+
+    CacheObj *cached;
+    int role = flight_join(c->req.key, &c->flight, &cached);
+    if (role == FLIGHT_HIT) {
+        conn_serve_hit(c, cached);
+        if (cache_ahead_due(cached)) {
+            cache_retain(cached);
+            refresh_submit(&c->req, NULL, cached);
+        }
+        return 0;
+    }
+    if (cached && role != FLIGHT_HIT && stale_usable(cached, 0)) {
+        // stale-while-revalidate: 만료된 것을 바로 보내고, 갱신은 리더만 재검증 스레드로 넘김
+        conn_serve_hit(c, cached);
+        if (role == FLIGHT_LEAD) {
+            cache_retain(cached);
+            refresh_submit(&c->req, c->flight, cached);
+        } else {
+            flight_leave(c->flight);
+        }
+        c->flight = NULL;
+        return 0;
+    }
+    if (c->req.range) {
+        // 전체 객체를 한 번만 받아 캐시에서 잘라 줌. 캐시에 못 들어가면 Range 를 붙여 리더 아닌 채로 직접
+        if (range_follow(&c->req, role, c->flight, cached) == 0) {
+            role = FLIGHT_FOLLOW;
+            c->range_wait = 1;
+        } else {
+            c->flight = NULL;
+        }
+        range_headers(&c->arena, &c->req, &hdrs);
+        cached = NULL;
+    } else if (role == FLIGHT_LEAD) {
+        c->leader = 1;
+        c->resp.flight = c->flight;   // 어디서 실패하든 conn_close 가 flight 를 끝냄
+    }
+
+    // 만료된 객체가 있으면 조건부 요청으로 재검증 (검증자가 없어도 서버 실패 대비로 들고 있음)
+    c->stale = cached;
+    c->revalidating = cached && add_validators(&c->arena, &hdrs, cached);
+
+    int n;
+    c->reqbuf = build_request(&c->arena, c->req.path, c->req.host, hdrs.s ? hdrs.s : "", has_host, &n);
+    c->key = c->req.key;
+    if (!c->reqbuf) return -1;
+    c->reqlen = (size_t)n;
+
+    if (role == FLIGHT_FOLLOW && c->flight) {
+        c->st = C_FOLLOW;
+        return conn_follow(c);
+    }
+    return conn_connect(c);
 }
 
-void put_cache(const char *key, const char *blob, size_t n) {
-    if (n > MAX_OBJECT_SIZE) return;
+// FlightWaiter.wake: 리더 스레드나 조회 스레드에서 불림. 연결을 원래 루프로 넘김
+static void conn_wake(FlightWaiter *w) {
+    Conn *c = (Conn *)((char *)w - offsetof(Conn, waiter));
+    Loop *l = c->loop;
+
+    pthread_mutex_lock(&l->mu);
+    c->mail_next = l->mail;
+    l->mail = c;
+    pthread_mutex_unlock(&l->mu);
+
+    uint64_t one = 1;
+    ssize_t rc = write(l->wakefd, &one, sizeof(one));
+    (void)rc;   // 카운터가 이미 쌓여 있어도 깨어나기만 하면 됨
+}
 
-    pthread_rwlock_wrlock(&g_cache.rw);  
+// 깨어난 연결들 처리 (따라 읽기 / 주소 조회 끝)
+static void loop_drain_mail(Loop *l) {
+    uint64_t cnt;
+    ssize_t rc = read(l->wakefd, &cnt, sizeof(cnt));
+    (void)rc;
 
-    // 중복 키 있으면 삭제 후 넣기
-    Entry *dupe = find_entry(key);
-    if (dupe) {
-        g_cache.bytes_used -= dupe->size;
-        list_remove_nolock(dupe);
-        free_entry(dupe);
+    pthread_mutex_lock(&l->mu);
+    Conn *c = l->mail;
+    l->mail = NULL;
+    pthread_mutex_unlock(&l->mu);
+
+    while (c) {
+        Conn *next = c->mail_next;
+        c->armed = 0;
+        int r = c->dead ? -1 : c->st == C_RESOLVING ? conn_connect_addrs(c) : conn_follow(c);
+        if (r < 0) conn_close(c);
+        c = next;
     }
+}
+
+// in 버퍼에 최소 한 바이트 + NUL 자리 확보. 헤더가 너무 크면 -1
+static int in_reserve(Conn *c) {
+    if (c->in_len + 1 < c->in_cap) return 0;
+    if (c->in_cap >= REQ_MAX) return -1;
+    size_t cap = c->in_cap ? c->in_cap * 2 : 1024;
+    char *p = realloc(c->in, cap);
+    if (!p) return -1;
+    c->in = p;
+    c->in_cap = cap;
+    return 0;
+}
 
-    // 가장 오래 안 쓴 것부터 제거
-    while (g_cache.bytes_used + n > MAX_CACHE_SIZE) {
-        Entry *oldest = find_oldest();
-        if (!oldest) break;
-        g_cache.bytes_used -= oldest->size;
-        list_remove_nolock(oldest);
-        free_entry(oldest);
+static int on_client_readable(Conn *c) {
+    while (1) {
+        if (in_reserve(c) < 0) return -1;
+        ssize_t n = read(c->clientfd, c->in + c->in_len, c->in_cap - c->in_len - 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        if (n == 0) return -1;
+        c->in_len += (size_t)n;
+        c->in[c->in_len] = '\0';
+        if (strstr(c->in, "\r\n\r\n")) return conn_start(c);
     }
+}
 
-    // 새 엔트리 생성
-    Entry *new_enty = (Entry *)malloc(sizeof(*new_enty));
-    // if (!new_enty) { pthread_rwlock_unlock(&g_cache.rw); return; }
-    new_enty->key = strdup(key);
-    new_enty->data = (char *)malloc(n);
-    if (!new_enty->key || !new_enty->data) {
-        free(new_enty->key); 
-        free(new_enty->data); 
-        free(new_enty);
-        pthread_rwlock_unlock(&g_cache.rw);
-        return;
+static int relay_from_server(Conn *c);
+
+/* 서버 응답 헤더를 in 에 모음 (요청 파싱은 끝났으니 버퍼 재사용).
+  다 모이면 저장 여부를 정하고 relay 로 넘어감. 재검증에 304 가 오면 저장된 응답을 보냄 */
+static int read_resp_header(Conn *c) {
+    while (1) {
+        if (in_reserve(c) < 0) return -1;
+        ssize_t n = read(c->serverfd, c->in + c->in_len, c->in_cap - c->in_len - 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->in_len += (size_t)n;
+        size_t end = http_header_end(c->in, c->in_len);
+        if (!end && n > 0) continue;
+        int whole = end != 0;
+        if (!whole) end = c->in_len;
+        if (!c->in_len || (c->stale && origin_5xx(c->in, end) && stale_usable(c->stale, 1)))
+            return conn_origin_error(c, 0);
+
+        if (resp_headers(&c->resp, c->key, c->in, end, c->revalidating && whole ? c->stale : NULL)) {
+            // 304: 서버 연결은 닫고 저장된 응답을 히트처럼 보냄
+            close(c->serverfd);
+            c->serverfd = -1;
+            if (c->resp.flight) flight_append(c->resp.flight, c->stale->data, c->stale->size);
+            c->resp.cacheable = 0;
+            resp_finish(&c->resp, c->key, 1);
+            conn_serve_hit(c, c->stale);
+            c->stale = NULL;
+            return 0;
+        }
+        if (!whole) resp_nostore(&c->resp);   // 헤더 끝 전에 닫힘: 받은 것만 넘기고 저장은 안 함
+        cache_release(c->stale);
+        c->stale = NULL;
+
+        // 헤더와 같이 들어온 본문 앞부분까지 첫 조각으로
+        resp_append(&c->resp, c->in, c->in_len);
+        c->out = c->in;
+        c->out_len = c->in_len;
+        c->out_off = 0;
+        c->st = C_RELAY;
+        int r = conn_flush(c, c->clientfd);
+        if (r < 0) return -1;
+        if (r == 0) {
+            ep_set(c, &c->h_srv, c->serverfd, 0, EPOLL_CTL_MOD);
+            ep_set(c, &c->h_cli, c->clientfd, EPOLLOUT, EPOLL_CTL_MOD);
+            return 0;
+        }
+        return relay_from_server(c);
     }
-    memcpy(new_enty->data, blob, n);
-    new_enty->size = n;
-    new_enty->prev = new_enty->next = NULL;
+}
 
-    unsigned long t = atomic_fetch_add_explicit(&g_ticks, 1, memory_order_relaxed);
-    atomic_store_explicit(&new_enty->last_use, t, memory_order_relaxed);
+// 서버 응답을 읽어서 클라이언트로. 클라이언트가 막히면 서버 읽기를 멈춤
+static int relay_from_server(Conn *c) {
+    if (c->out_off < c->out_len) return 0;   // 아직 클라이언트로 못 보낸 조각이 있음
+    while (1) {
+        ssize_t n = read(c->serverfd, c->io, MAXLINE);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        if (n == 0) {
+            resp_finish(&c->resp, c->key, 1);
+            return -1;                                   // 정상 종료도 연결 정리
+        }
+        resp_append(&c->resp, c->io, (size_t)n);
 
-    insert_first(new_enty);
-    g_cache.bytes_used += n;
+        c->out = c->io;
+        c->out_len = (size_t)n;
+        c->out_off = 0;
+        int r = conn_flush(c, c->clientfd);
+        if (r < 0) return -1;
+        if (r == 0) {
+            ep_set(c, &c->h_srv, c->serverfd, 0, EPOLL_CTL_MOD);
+            ep_set(c, &c->h_cli, c->clientfd, EPOLLOUT, EPOLL_CTL_MOD);
+            return 0;
+        }
+    }
+}
 
-    pthread_rwlock_unlock(&g_cache.rw);
+static int server_step(Conn *c, uint32_t events) {
+    if ((events & EPOLLERR) && c->st != C_CONNECTING) return -1;
+    switch (c->st) {
+    case C_CONNECTING: {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c->serverfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) return -1;
+        c->st = C_SEND_REQ;
+    }   /* fall through */
+    case C_SEND_REQ: {
+        int r = conn_flush(c, c->serverfd);
+        if (r <= 0) return r;
+        c->out = NULL;
+        if (!(c->io = arena_alloc(&c->arena, MAXLINE))) return -1;
+        c->in_len = 0;
+        c->st = C_RESP_HDR;
+        ep_set(c, &c->h_srv, c->serverfd, EPOLLIN, EPOLL_CTL_MOD);
+        return 0;
+    }
+    case C_RESP_HDR:
+        return read_resp_header(c);
+    case C_RELAY:
+        return relay_from_server(c);
+    default:
+        return (events & (EPOLLERR | EPOLLHUP)) ? -1 : 0;
+    }
 }
 
+// 응답을 보내기 시작하기 전의 서버 실패는 stale-if-error 로 살릴 수 있음
+static int on_server_event(Conn *c, uint32_t events) {
+    int r = server_step(c, events);
+    if (r >= 0) return r;
+    if (c->st == C_CONNECTING) {
+        origin_mark_down(&c->arena, &c->req);   // 비동기 connect 실패
+        return conn_origin_error(c, 1);
+    }
+    if (c->st == C_SEND_REQ || c->st == C_RESP_HDR) return conn_origin_error(c, 0);
+    return r;
+}
+
+static int on_client_event(Conn *c, uint32_t events) {
+    if (c->st == C_FOLLOW || c->st == C_RESOLVING) {
+        if (!(events & (EPOLLERR | EPOLLHUP))) return c->st == C_FOLLOW ? conn_follow(c) : 0;
+        if (!c->armed) return -1;
+        // waiter 가 flight 에 걸려 있으니 여기서 해제하면 안 됨. 깨어날 때 정리
+        c->dead = 1;
+        epoll_ctl(c->loop->epfd, EPOLL_CTL_DEL, c->clientfd, NULL);
+        return 0;
+    }
+    if (events & EPOLLERR) return -1;
+    switch (c->st) {
+    case C_READ_REQ:
+        return on_client_readable(c);
+    case C_SEND_HIT:
+        return conn_flush_hit(c) == 0 ? 0 : -1;  // 다 보내면 종료
+    case C_RELAY: {
+        int r = conn_flush(c, c->clientfd);
+        if (r <= 0) return r;
+        ep_set(c, &c->h_cli, c->clientfd, 0, EPOLL_CTL_MOD);
+        ep_set(c, &c->h_srv, c->serverfd, EPOLLIN, EPOLL_CTL_MOD);
+        return 0;
+    }
+    default:
+        return (events & (EPOLLERR | EPOLLHUP)) ? -1 : 0;
+    }
+}
+
+static void accept_all(Loop *l, int listenfd) {
+    while (1) {
+        int fd = accept(listenfd, NULL, NULL);
+        if (fd < 0) return;   // EAGAIN: 다른 루프가 가져갔거나 더 없음
+        if (set_nonblock(fd) < 0) { close(fd); continue; }
+
+        Conn *c = calloc(1, sizeof(*c));
+        if (!c) { close(fd); continue; }
+        c->loop = l;
+        c->clientfd = fd;
+        c->serverfd = -1;
+        c->st = C_READ_REQ;
+        c->h_cli = (Handle){ c, H_CLI };
+        c->h_srv = (Handle){ c, H_SRV };
+        c->waiter.wake = conn_wake;
+        arena_init(&c->arena, CONN_ARENA_BLOCK);
+        ep_set(c, &c->h_cli, fd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+}
+
+static void *event_loop(void *arg) {
+    Shard *sh = arg;
+    int listenfd = sh->listenfd;
+    pin_to_cpu(sh->cpu);
+
+    Loop l = { .mail = NULL };
+    int epfd = l.epfd = epoll_create1(0);
+    if (epfd < 0) unix_error("epoll_create1 error");
+    if ((l.wakefd = eventfd(0, EFD_NONBLOCK)) < 0) unix_error("eventfd error");
+    pthread_mutex_init(&l.mu, NULL);
 
+    // 모든 루프가 같은 listenfd 를 보되, EPOLLEXCLUSIVE 로 하나만 깨움
+    struct epoll_event lev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &lev) < 0) unix_error("epoll_ctl error");
+
+    l.h_wake = (Handle){ NULL, H_WAKE };
+    struct epoll_event wev = { .events = EPOLLIN, .data.ptr = &l.h_wake };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, l.wakefd, &wev) < 0) unix_error("epoll_ctl error");
+
+    struct epoll_event evs[256];
+    while (1) {
+        int n = epoll_wait(epfd, evs, 256, -1);
+        for (int i = 0; i < n; i++) {
+            Handle *h = evs[i].data.ptr;
+            if (!h) {
+                accept_all(&l, listenfd);
+                continue;
+            }
+            if (h->kind == H_WAKE) {
+                loop_drain_mail(&l);
+                continue;
+            }
+            Conn *c = h->conn;
+            if (c->dead) continue;   // 이 묶음에서 이미 정리됨 (또는 깨어나기만 기다림)
+            int r = h->kind == H_SRV ? on_server_event(c, evs[i].events)
+                                     : on_client_event(c, evs[i].events);
+            if (r < 0) conn_close(c);
+        }
+        while (l.closing) {
+            Conn *c = l.closing;
+            l.closing = c->close_next;
+            conn_free(c);
+        }
+    }
+    return NULL;
+}
+
+// 루프 i 는 리스너 i % nshards 를 맡음. 샤드 모드면 루프마다 코어 고정
+static void run_event_loops(Shard *shards, int nshards, int nloops) {
+    if (nloops < nshards) nloops = nshards;
+    for (int i = 0; i < nshards; i++)
+        if (set_nonblock(shards[i].listenfd) < 0) unix_error("fcntl error");
+
+    Shard *loops = Calloc(nloops, sizeof(Shard));
+    for (int i = 0; i < nloops; i++) {
+        loops[i].listenfd = shards[i % nshards].listenfd;
+        loops[i].cpu = shards[0].cpu < 0 ? -1 : i;
+    }
+    for (int i = 1; i < nloops; i++) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, event_loop, &loops[i]);
+    }
+    event_loop(&loops[0]);
+}
@@ -0,0 +1,269 @@
+/*
+ * radix.c - 압축 radix tree (radix.h 참고)
+ *
+ * 불변식: 뿌리가 아닌 노드는 값이 있거나 자식이 둘 이상 (지울 때 합쳐서 유지).
+ * 자식은 간선 첫 글자로 찾음 (URL key 는 갈래가 적어서 선형 탐색으로 충분)
+ */
+#include "radix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct RadixNode {
+    char *label;           // 부모에서 오는 간선 (NUL 없음, 뿌리는 빈 간선)
+    size_t len;
+    int has;               // 여기서 끝나는 key 가 있음
+    void *val;
+    RadixNode **kids;
+    size_t nkids, cap;
+};
+
+static RadixNode *node_new(const char *label, size_t len) {
+    RadixNode *n = calloc(1, sizeof(*n));
+    if (!n) return NULL;
+    if (!(n->label = malloc(len ? len : 1))) {
+        free(n);
+        return NULL;
+    }
+    memcpy(n->label, label, len);
+    n->len = len;
+    return n;
+}
+
+static void node_free(RadixNode *n) {
+    if (!n) return;
+    free(n->kids);
+    free(n->label);
+    free(n);
+}
+
+static RadixNode *find_kid(const RadixNode *n, char c, size_t *idx) {
+    for (size_t i = 0; i < n->nkids; i++) {
+        if (n->kids[i]->label[0] == c) {
+            if (idx) *idx = i;
+            return n->kids[i];
+        }
+    }
+    return NULL;
+}
+
+static int add_kid(RadixNode *n, RadixNode *kid) {
+    if (n->nkids == n->cap) {
+        size_t cap = n->cap ? n->cap * 2 : 2;
+        RadixNode **k = realloc(n->kids, cap * sizeof(*k));
+        if (!k) return -1;
+        n->kids = k;
+        n->cap = cap;
+    }
+    n->kids[n->nkids++] = kid;
+    return 0;
+}
+
+static size_t common(const char *a, size_t alen, const char *b, size_t blen) {
+    size_t i = 0;
+    while (i < alen && i < blen && a[i] == b[i]) i++;
+    return i;
+}
+
+// 값 없이 자식 하나만 남은 노드를 그 자식과 합침 (실패하면 그대로 둬도 트리는 맞음)
+static void merge(RadixNode *x) {
+    RadixNode *c = x->kids[0];
+    char *label = malloc(x->len + c->len);
+    if (!label) return;
+    memcpy(label, x->label, x->len);
+    memcpy(label + x->len, c->label, c->len);
+    free(x->label);
+    free(x->kids);
+    x->label = label;
+    x->len += c->len;
+    x->has = c->has;
+    x->val = c->val;
+    x->kids = c->kids;
+    x->nkids = c->nkids;
+    x->cap = c->cap;
+    free(c->label);
+    free(c);
+}
+
+int radix_insert(Radix *t, const char *key, size_t len, void *val) {
+    if (!t->root && !(t->root = node_new("", 0))) return -1;
+    RadixNode *n = t->root;
+    size_t i = 0;
+
+    while (i < len) {
+        size_t k;
+        RadixNode *kid = find_kid(n, key[i], &k);
+        if (!kid) {
+            RadixNode *leaf = node_new(key + i, len - i);
+            if (!leaf || add_kid(n, leaf) < 0) {
+                node_free(leaf);
+                return -1;
+            }
+            n = leaf;
+            break;
+        }
+        size_t m = common(kid->label, kid->len, key + i, len - i);
+        if (m < kid->len) {
+            // 간선 중간에서 갈라짐: 겹치는 앞부분을 새 노드로 떼어 냄
+            RadixNode *mid = node_new(kid->label, m);
+            char *rest = malloc(kid->len - m);
+            if (!mid || !rest || add_kid(mid, kid) < 0) {
+                node_free(mid);
+                free(rest);
+                return -1;
+            }
+            memcpy(rest, kid->label + m, kid->len - m);
+            free(kid->label);
+            kid->label = rest;
+            kid->len -= m;
+            n->kids[k] = mid;
+            kid = mid;
+        }
+        n = kid;
+        i += m;
+    }
+    if (!n->has) {
+        n->has = 1;
+        t->count++;
+    }
+    n->val = val;
+    return 0;
+}
+
+void *radix_get(const Radix *t, const char *key, size_t len) {
+    const RadixNode *n = t->root;
+    size_t i = 0;
+    if (!n) return NULL;
+
+    while (i < len) {
+        const RadixNode *kid = find_kid(n, key[i], NULL);
+        if (!kid || kid->len > len - i || memcmp(kid->label, key + i, kid->len)) return NULL;
+        n = kid;
+        i += kid->len;
+    }
+    return n->has ? n->val : NULL;
+}
+
+int radix_remove(Radix *t, const char *key, size_t len) {
+    RadixNode *parent = NULL, *n = t->root;
+    size_t pidx = 0, i = 0;
+    if (!n) return 0;
+
+    while (i < len) {
+        size_t k;
+        RadixNode *kid = find_kid(n, key[i], &k);
+        if (!kid || kid->len > len - i || memcmp(kid->label, key + i, kid->len)) return 0;
+        parent = n;
+        pidx = k;
+        n = kid;
+        i += kid->len;
+    }
+    if (!n->has) return 0;
+    n->has = 0;
+    n->val = NULL;
+    t->count--;
+    if (!parent) return 1;   // 빈 key (뿌리)
+
+    if (n->nkids == 0) {
+        // 잎은 떼어 냄. 값 없는 부모에 자식 하나만 남으면 합침
+        parent->kids[pidx] = parent->kids[--parent->nkids];
+        node_free(n);
+        if (parent != t->root && !parent->has && parent->nkids == 1) merge(parent);
+    } else if (n->nkids == 1) {
+        merge(n);
+    }
+    return 1;
+}
+
+// 부분 트리를 돌 때 쓰는 명시적 스택 칸 (깊은 트리에서도 스레드 스택을 안 씀)
+typedef struct {
+    const RadixNode *n;
+    size_t plen;           // 이 노드 간선 앞까지의 key 길이
+} Frame;
+
+// key 버퍼 길이를 len (+ NUL) 까지 확보
+static int buf_reserve(char **buf, size_t *cap, size_t len) {
+    if (len + 1 <= *cap) return 0;
+    size_t c = *cap ? *cap : 256;
+    while (c < len + 1) c *= 2;
+    char *p = realloc(*buf, c);
+    if (!p) return -1;
+    *buf = p;
+    *cap = c;
+    return 0;
+}
+
+long radix_prefix(const Radix *t, const char *prefix, size_t len,
+                  void (*fn)(void *arg, const char *key, size_t keylen, void *val), void *arg) {
+    const RadixNode *n = t->root;
+    size_t i = 0, plen = 0;
+    if (!n) return 0;
+
+    // prefix 를 다 쓸 때까지 내려감 (prefix 가 간선 중간에서 끝나도 그 간선 아래 전부가 일치)
+    while (i < len) {
+        const RadixNode *kid = find_kid(n, prefix[i], NULL);
+        if (!kid) return 0;
+        size_t m = common(kid->label, kid->len, prefix + i, len - i);
+        if (m < kid->len && m < len - i) return 0;
+        plen = i;
+        n = kid;
+        i += kid->len;
+    }
+
+    long calls = 0;
+    char *buf = NULL;
+    size_t bcap = 0;
+    Frame *stack = NULL;
+    size_t depth = 0, scap = 0;
+
+    // 시작 노드 간선 앞부분 (= prefix 중 시작 노드 전까지)
+    if (buf_reserve(&buf, &bcap, plen) < 0) goto oom;
+    memcpy(buf, prefix, plen);
+
+    if (!(stack = malloc(sizeof(*stack) * (scap = 16)))) goto oom;
+    stack[depth++] = (Frame){ n, plen };
+    while (depth) {
+        Frame f = stack[--depth];
+        size_t klen = f.plen + f.n->len;
+        if (buf_reserve(&buf, &bcap, klen) < 0) goto oom;
+        memcpy(buf + f.plen, f.n->label, f.n->len);
+        if (f.n->has) {
+            buf[klen] = '\0';
+            fn(arg, buf, klen, f.n->val);
+            calls++;
+        }
+        for (size_t k = 0; k < f.n->nkids; k++) {
+            if (depth == scap) {
+                Frame *s = realloc(stack, sizeof(*s) * (scap *= 2));
+                if (!s) goto oom;
+                stack = s;
+            }
+            stack[depth++] = (Frame){ f.n->kids[k], klen };
+        }
+    }
+    free(stack);
+    free(buf);
+    return calls;
+
+oom:
+    free(stack);
+    free(buf);
+    return -1;
+}
+
+void radix_free(Radix *t) {
+    // 해제할 노드 목록을 val 자리로 이어 감 (재귀도, 추가 할당도 없이)
+    RadixNode *list = t->root;
+    if (list) list->val = NULL;
+    while (list) {
+        RadixNode *n = list;
+        list = n->val;
+        for (size_t k = 0; k < n->nkids; k++) {
+            n->kids[k]->val = list;
+            list = n->kids[k];
+        }
+        node_free(n);
+    }
+    t->root = NULL;
+    t->count = 0;
+}
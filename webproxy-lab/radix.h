@@ -0,0 +1,38 @@
+/*
+ * radix.h - 문자열 key 용 압축 radix tree (PATRICIA)
+ *
+ * 간선마다 문자열 조각을 붙이고, 자식이 하나뿐이면서 값이 없는 노드는 합쳐 둠.
+ * 그래서 prefix 로 시작하는 key 들은 한 부분 트리에 모이고, 그 부분 트리를 찾는 데는
+ * prefix 길이만큼만 내려가면 됨 -> prefix 무효화가 전체 key 수와 무관하게 일치한 것만큼의 비용.
+ * 락은 없음 (쓰는 쪽이 감쌈)
+ */
+#ifndef __RADIX_H__
+#define __RADIX_H__
+
+#include <stddef.h>
+
+typedef struct RadixNode RadixNode;
+
+/* 0 으로 채운 구조체가 빈 트리 */
+typedef struct {
+    RadixNode *root;
+    size_t count;
+} Radix;
+
+/* key (len 바이트, NUL 은 없어도 됨) 에 val 을 둠. 이미 있으면 값만 바꿈. 메모리 부족 -1 */
+int radix_insert(Radix *t, const char *key, size_t len, void *val);
+
+/* key 의 값, 없으면 NULL (값 자체가 NULL 인 것과는 구분 안 함) */
+void *radix_get(const Radix *t, const char *key, size_t len);
+
+/* 있으면 빼고 1, 없으면 0 */
+int radix_remove(Radix *t, const char *key, size_t len);
+
+/* prefix 로 시작하는 key 마다 fn (key 는 NUL 로 끝남). fn 안에서 트리를 바꾸면 안 됨.
+   부른 횟수, 메모리 부족 -1 */
+long radix_prefix(const Radix *t, const char *prefix, size_t len,
+                  void (*fn)(void *arg, const char *key, size_t keylen, void *val), void *arg);
+
+void radix_free(Radix *t);
+
+#endif /* __RADIX_H__ */
@@ -0,0 +1,272 @@
+/*
+ * slab.c - 크기 클래스 할당기 (slab.h 참고)
+ */
+#include "slab.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SLAB_PAGE   (1024 * 1024)   /* 클래스가 한 번에 받아오는 페이지 (이 크기로 정렬) */
+#define SLAB_MIN    64              /* 가장 작은 청크 */
+#define SLAB_LARGE  (SLAB_PAGE / 8) /* 이보다 크면 mmap 직행 */
+#define SLAB_MAX_CLASSES 64
+#define SLAB_BATCH  16              /* 스레드 캐시가 한 번에 가져오고 돌려주는 최대 청크 수 */
+#define SLAB_BATCH_BYTES (64 * 1024) /* 큰 클래스는 이 바이트만큼만 묶음 (캐시에 쌓이는 양 제한) */
+#define SLAB_POOL   8               /* 클래스와 상관없이 남겨 두는 빈 페이지 수 */
+
+/* 페이지 맨 앞의 머리. 청크 주소를 SLAB_PAGE 로 내림하면 나옴 */
+typedef struct SlabPage {
+    struct SlabPage *prev, *next;   /* 클래스의 빈 자리 있는 페이지 목록 */
+    void *free;                     /* 반환된 청크 (첫 8바이트에 다음 포인터) */
+    char *cur;                      /* 아직 안 자른 부분 */
+    size_t left;
+    size_t used;                    /* 나가 있는 청크 수 (스레드 캐시 포함) */
+    int listed;
+} SlabPage;
+
+#define SLAB_HDR    ((sizeof(SlabPage) + 63) & ~(size_t)63)
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t size;        /* 청크 크기 */
+    int batch;          /* 스레드 캐시 묶음 크기 */
+    SlabPage *partial;  /* 빈 자리 있는 페이지들 */
+} SlabClass;
+
+/* 스레드별 클래스 캐시: 클래스 락은 묶음마다 한 번만 */
+typedef struct {
+    void *head;
+    int n;
+} SlabBin;
+
+static SlabClass g_classes[SLAB_MAX_CLASSES];
+static int g_nclasses;
+static size_t g_pagesz;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_bin_key;
+
+// 다 빈 페이지는 어느 클래스든 다시 씀. 넘치면 OS 로 돌려줌
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static SlabPage *g_pool;
+static int g_npool;
+
+static __thread SlabBin t_bins[SLAB_MAX_CLASSES];
+static __thread int t_bin_set;
+
+static void bins_flush(void *arg);
+
+// 64B 부터 25%씩 키운 클래스 (8바이트 정렬), 마지막은 SLAB_LARGE
+static void slab_setup(void) {
+    size_t sz = SLAB_MIN;
+    while (g_nclasses < SLAB_MAX_CLASSES - 1 && sz < SLAB_LARGE) {
+        pthread_mutex_init(&g_classes[g_nclasses].lock, NULL);
+        g_classes[g_nclasses++].size = sz;
+        sz = (sz + sz / 4 + 7) & ~(size_t)7;
+    }
+    pthread_mutex_init(&g_classes[g_nclasses].lock, NULL);
+    g_classes[g_nclasses++].size = SLAB_LARGE;
+    for (int c = 0; c < g_nclasses; c++) {
+        size_t b = SLAB_BATCH_BYTES / g_classes[c].size;
+        g_classes[c].batch = b < 1 ? 1 : b > SLAB_BATCH ? SLAB_BATCH : (int)b;
+    }
+
+    long ps = sysconf(_SC_PAGESIZE);
+    g_pagesz = ps > 0 ? (size_t)ps : 4096;
+
+    // 스레드가 끝날 때 캐시에 든 청크를 돌려놓음
+    pthread_key_create(&g_bin_key, bins_flush);
+}
+
+// n 을 담는 가장 작은 클래스, 없으면 -1 (큰 객체)
+static int class_of(size_t n) {
+    if (n > SLAB_LARGE) return -1;
+    int lo = 0, hi = g_nclasses - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g_classes[mid].size >= n) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+static SlabPage *page_of(void *p) {
+    return (SlabPage *)((uintptr_t)p & ~((uintptr_t)SLAB_PAGE - 1));
+}
+
+// SLAB_PAGE 로 정렬된 페이지. 풀에 있으면 그걸, 없으면 두 배로 받아 앞뒤를 잘라냄
+static SlabPage *page_get(void) {
+    pthread_mutex_lock(&g_pool_lock);
+    SlabPage *pg = g_pool;
+    if (pg) {
+        g_pool = pg->next;
+        g_npool--;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+    if (pg) return pg;
+
+    char *raw = mmap(NULL, 2 * SLAB_PAGE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *page = (char *)(((uintptr_t)raw + SLAB_PAGE - 1) & ~((uintptr_t)SLAB_PAGE - 1));
+    if (page > raw) munmap(raw, (size_t)(page - raw));
+    if (raw + 2 * SLAB_PAGE > page + SLAB_PAGE)
+        munmap(page + SLAB_PAGE, (size_t)(raw + 2 * SLAB_PAGE - (page + SLAB_PAGE)));
+    return (SlabPage *)page;
+}
+
+// 다 빈 페이지: 풀이 차 있으면 OS 로 (RSS 가 -m 을 넘어 계속 자라지 않게)
+static void page_put(SlabPage *pg) {
+    pthread_mutex_lock(&g_pool_lock);
+    if (g_npool < SLAB_POOL) {
+        // 풀에 두는 동안도 물리 메모리는 돌려줌 (주소 공간만 남김)
+        madvise((char *)pg + g_pagesz, SLAB_PAGE - g_pagesz, MADV_DONTNEED);
+        pg->next = g_pool;
+        g_pool = pg;
+        g_npool++;
+        pg = NULL;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+    if (pg) munmap(pg, SLAB_PAGE);
+}
+
+static void partial_add(SlabClass *sc, SlabPage *pg) {
+    pg->prev = NULL;
+    pg->next = sc->partial;
+    if (sc->partial) sc->partial->prev = pg;
+    sc->partial = pg;
+    pg->listed = 1;
+}
+
+static void partial_del(SlabClass *sc, SlabPage *pg) {
+    if (pg->prev) pg->prev->next = pg->next;
+    else sc->partial = pg->next;
+    if (pg->next) pg->next->prev = pg->prev;
+    pg->listed = 0;
+}
+
+// 클래스에서 최대 want 개를 bin 으로. 하나도 못 받으면 0
+static int bin_refill(SlabClass *sc, SlabBin *bin, int want) {
+    int got = 0;
+    pthread_mutex_lock(&sc->lock);
+    while (got < want) {
+        SlabPage *pg = sc->partial;
+        if (!pg) {
+            if (!(pg = page_get())) break;
+            pg->free = NULL;
+            pg->cur = (char *)pg + SLAB_HDR;
+            pg->left = SLAB_PAGE - SLAB_HDR;
+            pg->used = 0;
+            partial_add(sc, pg);
+        }
+        void *p;
+        if (pg->free) {
+            p = pg->free;
+            pg->free = *(void **)p;
+        } else {
+            p = pg->cur;
+            pg->cur += sc->size;
+            pg->left -= sc->size;
+        }
+        pg->used++;
+        if (!pg->free && pg->left < sc->size) partial_del(sc, pg);   // 꽉 참
+
+        *(void **)p = bin->head;
+        bin->head = p;
+        bin->n++;
+        got++;
+    }
+    pthread_mutex_unlock(&sc->lock);
+    return got;
+}
+
+// bin 에서 count 개를 각자의 페이지로 돌려줌. 다 빈 페이지는 풀로
+static void bin_drain(SlabClass *sc, SlabBin *bin, int count) {
+    SlabPage *empty = NULL;
+
+    pthread_mutex_lock(&sc->lock);
+    while (count-- > 0 && bin->head) {
+        void *p = bin->head;
+        bin->head = *(void **)p;
+        bin->n--;
+
+        SlabPage *pg = page_of(p);
+        *(void **)p = pg->free;
+        pg->free = p;
+        if (--pg->used == 0) {
+            if (pg->listed) partial_del(sc, pg);
+            pg->next = empty;
+            empty = pg;
+        } else if (!pg->listed) {
+            partial_add(sc, pg);
+        }
+    }
+    pthread_mutex_unlock(&sc->lock);
+
+    while (empty) {
+        SlabPage *next = empty->next;
+        page_put(empty);
+        empty = next;
+    }
+}
+
+static void bins_flush(void *arg) {
+    SlabBin *bins = arg;
+    for (int c = 0; c < g_nclasses; c++)
+        if (bins[c].n) bin_drain(&g_classes[c], &bins[c], bins[c].n);
+}
+
+static SlabBin *thread_bins(void) {
+    if (!t_bin_set) {
+        pthread_setspecific(g_bin_key, t_bins);
+        t_bin_set = 1;
+    }
+    return t_bins;
+}
+
+size_t slab_real_size(size_t n) {
+    pthread_once(&g_once, slab_setup);
+    int c = class_of(n);
+    if (c < 0) return (n + g_pagesz - 1) & ~(g_pagesz - 1);
+    return g_classes[c].size;
+}
+
+void *slab_alloc(size_t n, size_t *real) {
+    pthread_once(&g_once, slab_setup);
+    int c = class_of(n);
+
+    if (c < 0) {
+        size_t len = (n + g_pagesz - 1) & ~(g_pagesz - 1);
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        if (real) *real = len;
+        return p;
+    }
+
+    SlabClass *sc = &g_classes[c];
+    SlabBin *bin = &thread_bins()[c];
+    if (!bin->head && !bin_refill(sc, bin, sc->batch)) return NULL;
+    void *p = bin->head;
+    bin->head = *(void **)p;
+    bin->n--;
+
+    if (real) *real = sc->size;
+    return p;
+}
+
+void slab_free(void *p, size_t n) {
+    if (!p) return;
+    int c = class_of(n);
+    if (c < 0) {
+        munmap(p, (n + g_pagesz - 1) & ~(g_pagesz - 1));
+        return;
+    }
+    SlabClass *sc = &g_classes[c];
+    SlabBin *bin = &thread_bins()[c];
+    *(void **)p = bin->head;
+    bin->head = p;
+    // 너무 쌓이면 절반을 페이지로 돌려줌 (다른 스레드 / 다른 클래스가 쓸 수 있게)
+    if (++bin->n >= 2 * sc->batch) bin_drain(sc, bin, sc->batch);
+}
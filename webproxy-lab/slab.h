@@ -0,0 +1,24 @@
+/*
+ * slab.h - 캐시 객체용 크기 클래스 할당기
+ *
+ * 작은/중간 객체는 1MB 페이지를 같은 크기 청크로 잘라 페이지별 free list 로 관리.
+ * 같은 클래스 청크끼리만 재사용하므로 수백만 개를 넣고 빼도 외부 단편화가 없고,
+ * 내부 낭비는 클래스 간격(25%) 이하. 스레드마다 클래스별 캐시를 두고 묶음으로
+ * 가져오고 돌려줘서 클래스 락은 가끔만 잡음. 다 빈 페이지는 클래스를 가리지 않고
+ * 다시 쓰거나 OS 로 돌려줌. 큰 객체는 페이지 단위 mmap 으로 바로 받음
+ */
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stddef.h>
+
+/* n 바이트 할당. 실제로 차지하는 크기를 *real 에 (예산 계산용). 실패 시 NULL */
+void *slab_alloc(size_t n, size_t *real);
+
+/* slab_alloc(n, ...) 으로 받은 p 반환. n 은 할당 때와 같은 값 */
+void slab_free(void *p, size_t n);
+
+/* n 바이트를 할당하면 실제로 차지할 크기 */
+size_t slab_real_size(size_t n);
+
+#endif /* __SLAB_H__ */
@@ -0,0 +1,111 @@
+/*
+ * tinylfu.c - count-min sketch + doorkeeper (tinylfu.h 참고)
+ */
+#include "tinylfu.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define SK_ROWS   4
+#define SK_MAX    15      // 카운터 상한 (바이트에 담지만 aging 주기에 맞춰 작게)
+#define SK_MIN_W  1024
+
+static _Atomic unsigned char *g_sketch;   // SK_ROWS x g_width, 바이트 하나에 카운터 하나
+static size_t g_width;                    // 2의 거듭제곱
+static _Atomic uint64_t *g_door;          // doorkeeper 비트 (g_width * 8 비트)
+static size_t g_door_bits;
+static _Atomic size_t g_adds;             // 마지막 aging 이후 기록 수
+static size_t g_sample;
+static atomic_flag g_aging = ATOMIC_FLAG_INIT;
+
+static const uint64_t g_seeds[SK_ROWS] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+    0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL,
+};
+
+// splitmix64 마무리 단계. 행마다 seed 가 달라 서로 거의 독립인 위치가 나옴
+static uint64_t mix(uint64_t h, uint64_t seed) {
+    h += seed;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+void tinylfu_init(size_t items) {
+    size_t w = SK_MIN_W;
+    while (w < items * 4) w <<= 1;   // 행마다 엔트리의 4배 -> 충돌로 부풀려지는 값이 작음
+
+    g_sketch = calloc(SK_ROWS * w, 1);
+    g_door = calloc(w * 8 / 64, sizeof(uint64_t));
+    if (!g_sketch || !g_door) abort();
+    g_width = w;
+    g_door_bits = w * 8;
+    g_sample = 10 * (items > SK_MIN_W / 4 ? items : SK_MIN_W / 4);   // 엔트리 10배 기록마다 aging
+}
+
+// doorkeeper 비트 두 개 (해시 두 개)
+static size_t door_bit(uint64_t h, int i) {
+    return mix(h, g_seeds[i]) >> 7 & (g_door_bits - 1);
+}
+
+static int door_has(uint64_t h) {
+    for (int i = 0; i < 2; i++) {
+        size_t b = door_bit(h, i);
+        if (!(atomic_load_explicit(&g_door[b / 64], memory_order_relaxed) >> (b % 64) & 1)) return 0;
+    }
+    return 1;
+}
+
+// 비트를 켜고, 이미 다 켜져 있었으면 1
+static int door_put(uint64_t h) {
+    int had = 1;
+    for (int i = 0; i < 2; i++) {
+        size_t b = door_bit(h, i);
+        uint64_t m = 1ULL << (b % 64);
+        if (!(atomic_fetch_or_explicit(&g_door[b / 64], m, memory_order_relaxed) & m)) had = 0;
+    }
+    return had;
+}
+
+static _Atomic unsigned char *counter(uint64_t h, int row) {
+    return &g_sketch[row * g_width + (mix(h, g_seeds[row]) & (g_width - 1))];
+}
+
+// 카운터를 모두 반으로, doorkeeper 는 비움. 한 스레드만 (도는 동안의 기록 몇 개는 흐려져도 됨)
+static void sketch_age(void) {
+    if (atomic_flag_test_and_set(&g_aging)) return;
+    for (size_t i = 0; i < SK_ROWS * g_width; i++)
+        atomic_store_explicit(&g_sketch[i],
+                              atomic_load_explicit(&g_sketch[i], memory_order_relaxed) >> 1,
+                              memory_order_relaxed);
+    for (size_t i = 0; i < g_door_bits / 64; i++)
+        atomic_store_explicit(&g_door[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&g_adds, 0, memory_order_relaxed);
+    atomic_flag_clear(&g_aging);
+}
+
+void tinylfu_record(uint64_t h) {
+    if (!g_sketch) return;
+    if (door_put(h)) {
+        for (int r = 0; r < SK_ROWS; r++) {
+            _Atomic unsigned char *c = counter(h, r);
+            if (atomic_load_explicit(c, memory_order_relaxed) < SK_MAX)
+                atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+        }
+    }
+    if (atomic_fetch_add_explicit(&g_adds, 1, memory_order_relaxed) + 1 >= g_sample) sketch_age();
+}
+
+int tinylfu_estimate(uint64_t h) {
+    if (!g_sketch) return 0;
+    int min = SK_MAX;
+    for (int r = 0; r < SK_ROWS; r++) {
+        int c = atomic_load_explicit(counter(h, r), memory_order_relaxed);
+        if (c < min) min = c;
+    }
+    return min + door_has(h);
+}
+
+int tinylfu_admit(uint64_t candidate, uint64_t victim) {
+    return tinylfu_estimate(candidate) > tinylfu_estimate(victim);
+}
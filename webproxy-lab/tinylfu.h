@@ -0,0 +1,28 @@
+/*
+ * tinylfu.h - 캐시 입장 허가용 빈도 스케치 (TinyLFU)
+ *
+ * count-min sketch (4 행, 15 에서 멈추는 1바이트 카운터) 로 key 해시별 최근 접근 횟수를 근사.
+ * 카운터마다 바이트 하나라 락 없이 atomic 으로 올림 (4비트로 묶는 것보다 두 배 크지만 CAS 가 필요 없음).
+ * 처음 보는 key 는 doorkeeper (Bloom filter) 에만 표시하고 두 번째부터 스케치에 셈
+ * -> 한 번 보고 마는 URL 들이 스케치를 더럽히지 않음.
+ * 기록이 sample 번 쌓이면 모든 카운터를 반으로 줄이고 doorkeeper 를 비움 (aging)
+ */
+#ifndef __TINYLFU_H__
+#define __TINYLFU_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* items = 캐시에 들어갈 것으로 보는 엔트리 수 (스케치 크기 / aging 주기 기준) */
+void tinylfu_init(size_t items);
+
+/* 접근 하나 기록 (히트/미스 모두). 락 없이 여러 스레드에서 불러도 됨 (근사치) */
+void tinylfu_record(uint64_t h);
+
+/* 추정 빈도 (doorkeeper 포함) */
+int tinylfu_estimate(uint64_t h);
+
+/* 새 후보가 내보낼 희생자보다 자주 쓰였으면 1 */
+int tinylfu_admit(uint64_t candidate, uint64_t victim);
+
+#endif /* __TINYLFU_H__ */
@@ -0,0 +1,183 @@
+/*
+ * tracesim.c - 치우친 요청 흐름에서 교체 정책 / 입장 허가별 캐시 적중률 비교
+ *
+ *   usage: ./tracesim [-P policies] [-k keys] [-s zipf_skew] [-r requests] [-b obj_bytes]
+ *                     [-S scan_len] [-p scan_every] [-f trace_file]
+ *
+ * keys 개 URL 에 Zipf 분포로 요청하면서 scan_every 요청마다 한 번씩만 보이는 URL 을
+ * scan_len 개 연달아 섞음 (크롤러, 목록 페이지 순회 같은 일회성 요청).
+ * -b 0 이면 객체 크기를 URL 마다 256B ~ 100KB 사이 로그 균등으로 고정해서 줌 (작은 HTML 과 큰 이미지).
+ * -f 면 만든 흐름 대신 파일의 요청을 재생 (한 줄에 "URL [크기]", 크기가 없으면 -b 규칙).
+ * 프록시처럼 get_cache 가 미스면 put_cache 하고, -P 의 정책 (쉼표 구분) 마다
+ * TinyLFU 끔/켬 으로 각각 새 프로세스에서 같은 흐름을 돌려 객체/바이트 적중률을 출력함
+ */
+#include "cache.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIXED_MIN 256
+
+static int g_keys = 20000, g_requests = 500000, g_obj = 4096, g_scan = 2000, g_every = 20000;
+static double g_skew = 0.9;
+
+// -f 로 읽은 요청들
+typedef struct {
+    char *key;
+    size_t size;
+} TraceReq;
+static TraceReq *g_trace;
+static int g_ntrace;
+
+// Zipf 누적 분포 (rank 0 이 가장 인기)
+static double *zipf_cdf(int n, double s) {
+    double *cdf = malloc(sizeof(double) * n), sum = 0;
+    for (int i = 0; i < n; i++) cdf[i] = (sum += 1.0 / pow(i + 1, s));
+    for (int i = 0; i < n; i++) cdf[i] /= sum;
+    return cdf;
+}
+
+static int zipf_pick(const double *cdf, int n, unsigned *seed) {
+    double u = rand_r(seed) / ((double)RAND_MAX + 1);
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// URL 마다 고정된 크기. 인기와는 무관
+static size_t obj_size(uint64_t id) {
+    if (g_obj) return (size_t)g_obj;
+    id = (id + 1) * 0x9e3779b97f4a7c15ULL;
+    id ^= id >> 31;
+    double u = (double)(id % 1000000) / 1000000.0;
+    return (size_t)(MIXED_MIN * pow((double)cache_max_object() / MIXED_MIN, u));
+}
+
+static void load_trace(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    char line[1024], key[1024];
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        long size = 0;
+        if (sscanf(line, "%1023s %ld", key, &size) < 1) continue;
+        if (g_ntrace == cap) {
+            cap = cap ? cap * 2 : 4096;
+            g_trace = realloc(g_trace, sizeof(TraceReq) * cap);
+            if (!g_trace) exit(1);
+        }
+        g_trace[g_ntrace].key = strdup(key);
+        // 크기가 없으면 URL 해시로 고정 크기를 정함
+        uint64_t h = 14695981039346656037ULL;
+        for (const char *p = key; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+        g_trace[g_ntrace++].size = size > 0 ? (size_t)size : obj_size(h);
+    }
+    fclose(fp);
+    g_requests = g_ntrace;
+}
+
+// 한 설정으로 흐름 전체를 돌리고 적중률 출력 (매번 같은 seed -> 같은 흐름)
+static void run(const char *policy, int admission) {
+    if (cache_set_policy(policy) < 0) {
+        fprintf(stderr, "unknown policy %s (%s)\n", policy, cache_policy_names());
+        exit(1);
+    }
+    cache_set_admission(admission);
+    cache_init(0, 0, 0);
+
+    double *cdf = zipf_cdf(g_keys, g_skew);
+    char *blob = calloc(1, cache_max_object());
+    unsigned seed = 12345;
+    long hits = 0, hot_hits = 0, hot_reqs = 0, scan_id = 0;
+    double bytes = 0, hit_bytes = 0;
+    char key[1024];
+
+    for (int i = 0; i < g_requests; i++) {
+        int hot = g_trace || !(g_every > 0 && i % g_every >= g_every - g_scan);
+        size_t n;
+        if (g_trace) {
+            snprintf(key, sizeof(key), "%s", g_trace[i].key);
+            n = g_trace[i].size;
+        } else if (hot) {
+            int r = zipf_pick(cdf, g_keys, &seed);
+            snprintf(key, sizeof(key), "sim.local:80/obj/%d", r);
+            n = obj_size((uint64_t)r);
+        } else {
+            snprintf(key, sizeof(key), "sim.local:80/scan/%ld", scan_id);
+            n = obj_size((uint64_t)(g_keys + scan_id++));
+        }
+
+        CacheObj *obj = get_cache(key);
+        if (obj) {
+            cache_release(obj);
+            hits++;
+            hot_hits += hot;
+            hit_bytes += n;
+        } else {
+            put_cache(key, blob, n, time(NULL) + 3600);
+        }
+        hot_reqs += hot;
+        bytes += n;
+    }
+    printf("%-8s %-9s %10.2f%% %10.2f%% %10.2f%%\n", policy, admission ? "tinylfu" : "-",
+           100.0 * hits / g_requests, 100.0 * hit_bytes / bytes,
+           hot_reqs ? 100.0 * hot_hits / hot_reqs : 0.0);
+}
+
+int main(int argc, char **argv) {
+    char *policies = "clock", *trace = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "P:k:s:r:b:S:p:f:")) != -1) {
+        switch (opt) {
+        case 'P': policies = optarg; break;
+        case 'k': g_keys = atoi(optarg); break;
+        case 's': g_skew = atof(optarg); break;
+        case 'r': g_requests = atoi(optarg); break;
+        case 'b': g_obj = atoi(optarg); break;
+        case 'S': g_scan = atoi(optarg); break;
+        case 'p': g_every = atoi(optarg); break;
+        case 'f': trace = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-P policy,...] [-k keys] [-s zipf_skew] [-r requests] "
+                    "[-b obj_bytes (0: mixed)] [-S scan_len] [-p scan_every] [-f trace_file]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (g_keys <= 0 || g_requests <= 0 || g_obj < 0 || g_scan < 0 || g_scan > g_every) exit(1);
+
+    char obj[32] = "mixed";
+    if (g_obj) snprintf(obj, sizeof(obj), "%dB", g_obj);
+    if (trace) {
+        load_trace(trace);
+        printf("cache=%zuB trace=%s requests=%d\n", cache_capacity(), trace, g_ntrace);
+    } else printf("cache=%zuB keys=%d skew=%.2f requests=%d obj=%s scan=%d/%d\n", cache_capacity(),
+           g_keys, g_skew, g_requests, obj, g_scan, g_every);
+    printf("%-8s %-9s %11s %11s %11s\n", "policy", "admission", "hit ratio", "byte hits", "zipf hits");
+    fflush(stdout);
+
+    // 캐시는 프로세스 전역이라 설정마다 새로 fork
+    for (char *p = strtok(policies, ","); p; p = strtok(NULL, ",")) {
+        for (int admission = 0; admission <= 1; admission++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                run(p, admission);
+                exit(0);
+            }
+            waitpid(pid, NULL, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * uring.c - io_uring 최소 래퍼 (uring.h 참고)
+ */
+#include "uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+int uring_init(uring_t *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        // SQ/CQ 링을 한 번에 매핑
+        if (r->cq_sz > r->sq_sz) r->sq_sz = r->cq_sz;
+        r->cq_sz = r->sq_sz;
+    }
+
+    r->sq_ptr = mmap(NULL, r->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) goto fail;
+    }
+
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // 버퍼를 커널에 등록해 두면 매 요청마다 페이지 pin/unpin 을 안 함
+    r->bufs = mmap(NULL, (size_t)URING_NBUF * URING_BUFSZ, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r->bufs == MAP_FAILED) { r->bufs = NULL; goto fail; }
+
+    struct iovec iov[URING_NBUF];
+    for (int i = 0; i < URING_NBUF; i++) {
+        iov[i].iov_base = uring_buf(r, i);
+        iov[i].iov_len = URING_BUFSZ;
+    }
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, iov, URING_NBUF) < 0)
+        goto fail;
+    return 0;
+
+fail: {
+        int saved = errno;
+        uring_free(r);
+        errno = saved;
+        return -1;
+    }
+}
+
+void uring_free(uring_t *r) {
+    if (r->bufs) munmap(r->bufs, (size_t)URING_NBUF * URING_BUFSZ);
+    if (r->sqes && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ptr && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_sz);
+    if (r->sq_ptr && r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_sz);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static struct io_uring_sqe *get_sqe(uring_t *r) {
+    unsigned tail = *r->sq_tail + r->sq_pending;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_pending++;
+    return sqe;
+}
+
+void uring_prep_read_fixed(uring_t *r, int fd, int idx, size_t len,
+                           unsigned long long user_data) {
+    struct io_uring_sqe *sqe = get_sqe(r);
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(unsigned long)uring_buf(r, idx);
+    sqe->len = (unsigned)len;
+    sqe->buf_index = (unsigned short)idx;
+    sqe->user_data = user_data;
+}
+
+void uring_prep_write_fixed(uring_t *r, int fd, int idx, size_t off, size_t len,
+                            unsigned long long user_data) {
+    struct io_uring_sqe *sqe = get_sqe(r);
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(unsigned long)(uring_buf(r, idx) + off);
+    sqe->len = (unsigned)len;
+    sqe->buf_index = (unsigned short)idx;
+    sqe->user_data = user_data;
+}
+
+int uring_submit_wait(uring_t *r, unsigned nwait) {
+    unsigned n = r->sq_pending;
+
+    // sqe 내용이 tail 갱신보다 먼저 보이도록 release
+    __atomic_store_n(r->sq_tail, *r->sq_tail + n, __ATOMIC_RELEASE);
+    r->sq_pending = 0;
+
+    while (1) {
+        long rc = syscall(__NR_io_uring_enter, r->fd, n, nwait, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc >= 0) return 0;
+        if (errno != EINTR) return -1;
+        // 이미 제출된 sqe 는 커널이 다시 가져가지 않으므로 n 그대로 재시도
+    }
+}
+
+int uring_reap(uring_t *r, unsigned long long *user_data, int *res) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+    struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
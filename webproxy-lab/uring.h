@@ -0,0 +1,55 @@
+/*
+ * uring.h - liburing 없이 io_uring 시스템 콜을 직접 쓰는 최소 래퍼
+ *
+ * 링 하나에 고정 크기 버퍼 URING_NBUF 개를 등록해 두고
+ * READ_FIXED / WRITE_FIXED 를 묶어서 한 번의 io_uring_enter 로 제출함
+ */
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+#define URING_NBUF  2             /* 등록 버퍼 수 (더블 버퍼링) */
+#define URING_BUFSZ (64 * 1024)   /* 등록 버퍼 하나 크기 */
+
+typedef struct {
+    int fd;
+
+    /* SQ 링 */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_pending;          /* 아직 제출 안 한 sqe 수 */
+
+    /* CQ 링 */
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* munmap 용 */
+    void *sq_ptr, *cq_ptr;
+    size_t sq_sz, cq_sz, sqes_sz;
+
+    char *bufs;                   /* URING_NBUF * URING_BUFSZ, 커널에 등록됨 */
+} uring_t;
+
+/* 성공 0, io_uring 을 못 쓰면 -1 (errno 유지) */
+int uring_init(uring_t *r, unsigned entries);
+void uring_free(uring_t *r);
+
+static inline char *uring_buf(uring_t *r, int idx) {
+    return r->bufs + (size_t)idx * URING_BUFSZ;
+}
+
+/* 등록 버퍼 idx 의 [off, off+len) 로 읽기/쓰기 예약 */
+void uring_prep_read_fixed(uring_t *r, int fd, int idx, size_t len,
+                           unsigned long long user_data);
+void uring_prep_write_fixed(uring_t *r, int fd, int idx, size_t off, size_t len,
+                            unsigned long long user_data);
+
+/* 예약한 sqe 를 전부 제출하고 완료가 nwait 개 이상 될 때까지 대기. 실패 -1 */
+int uring_submit_wait(uring_t *r, unsigned nwait);
+
+/* 완료 하나 꺼내기. 있으면 1, 없으면 0 */
+int uring_reap(uring_t *r, unsigned long long *user_data, int *res);
+
+#endif /* __URING_H__ */